@@ -47,8 +47,15 @@ class ChannelConverter {
 };
 
 
-// buffer which is used to exchange data
+// buffer which is used to exchange data: the A2DP callback and the loop() are running in different tasks
+#if A2DP_STATIC_BUFFER
+// allocated at compile time: the size is rounded up to the next power of 2
+RingBufferT<uint8_t, nextPowerOf2(A2DP_BUFFER_SIZE*A2DP_BUFFER_COUNT)> a2dp_buffer;
+#elif defined(USE_ATOMIC) && A2DP_LOCK_FREE
+AtomicRingBuffer<uint8_t> a2dp_buffer(A2DP_BUFFER_SIZE*A2DP_BUFFER_COUNT);
+#else
 RingBuffer<uint8_t> a2dp_buffer(A2DP_BUFFER_SIZE*A2DP_BUFFER_COUNT);
+#endif
 // flag to indicated that we are ready to process data
 volatile bool is_a2dp_active = false;
 
@@ -103,7 +110,7 @@ void a2dp_stream_sink_sound_data(const uint8_t* data, uint32_t len) {
  *
  * Because we support only one instance the class is implemented as singleton!
  */
-class A2DPStream : public Stream {
+class A2DPStream : public AudioStream {
     public:
         // Release the allocate a2dp_source or a2dp_sink
         ~A2DPStream(){
@@ -199,14 +206,6 @@ class A2DPStream : public Stream {
             return result;
         }
 
-        virtual size_t write(uint8_t c) {
-            LOGE( "write(char) not supported");
-            return -1;
-        }
-
-        virtual void flush() {
-        }
-
         /// Reads the data from the temporary buffer
         virtual size_t readBytes(uint8_t *data, size_t len) { 
             size_t result = 0; 
@@ -221,23 +220,12 @@ class A2DPStream : public Stream {
             return result;
         }
 
-        // not supported
-        virtual int read() {
-            LOGE( "read() not supported");
-            return -1;
-        }
-        // not supported
-        virtual int peek() {
-            LOGE( "peek() not supported");
-            return -1;
-        }
-       
         virtual int available() {
-            return a2dp_buffer.available();
+            return is_a2dp_active ? a2dp_buffer.available() : 0;
         }
 
-        virtual int availableToWrite() {
-            return a2dp_buffer.availableToWrite();
+        virtual int availableForWrite() {
+            return is_a2dp_active ? a2dp_buffer.availableToWrite() : 0;
         }
 
     protected:
@@ -248,6 +236,9 @@ class A2DPStream : public Stream {
 
         A2DPStream() {
             LOGI("A2DPStream");
+            audio_info.sample_rate = 44100;
+            audio_info.channels = 2;
+            audio_info.bits_per_sample = 16;
         }
 
 };
@@ -6,6 +6,7 @@
 
 #include "Stream.h"
 #include "AudioTools/AudioTypes.h"
+#include "AudioTools/Allocator.h"
 #include "AudioCodecs/ext/minimp3/minimp3.h"
 
 namespace audio_tools {
@@ -107,6 +108,11 @@ class MP3DecoderMini : public AudioDecoder  {
             this->out = &out_stream;
 		}
 
+        /// Defines the allocator which is used for the input buffer
+        void setAllocator(Allocator &allocator){
+            this->allocator = &allocator;
+        }
+
         /// Starts the processing
         virtual void begin(){
             begin(16*1024);
@@ -127,7 +133,7 @@ class MP3DecoderMini : public AudioDecoder  {
             flush();
             active = false;
             // release buffer
-            delete[] buffer;
+            allocator->removeArray(buffer, buffer_alloc_len);
             buffer = nullptr;
         }
 
@@ -154,13 +160,7 @@ class MP3DecoderMini : public AudioDecoder  {
 
         /// Decodes the last outstanding data
         void flush() {
-            if (buffer_pos>0 && buffer!=nullptr){
-             	LOGD(__FUNCTION__);
-                size_t consumed = writeBuffer(buffer, buffer_pos);
-                buffer_pos -= consumed;
-                // move not consumed bytes to the head
-                memmove(buffer, buffer+consumed, buffer_pos);
-            }
+            decodeBuffer(true);
         }
 
         /// checks if the class is active 
@@ -179,21 +179,45 @@ class MP3DecoderMini : public AudioDecoder  {
         size_t buffer_len = 16*1024;
         size_t buffer_pos = 0;
         uint8_t *buffer=nullptr;
+        size_t buffer_alloc_len = 0;
+        Allocator *allocator = &defaultAllocator();
         short pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
         bool active;
         bool is_output_valid;
+        // max frame size + next header: a frame can only be decoded w/o resetting the decoder if the next header is available 
+        const size_t frame_lookahead = 2304 + 4;
+
+        // Decodes the buffered data: if all is false we keep the last frame until we have received the next header
+        void decodeBuffer(bool all) {
+            if (buffer_pos>0 && buffer!=nullptr){
+             	LOGD(__FUNCTION__);
+                size_t consumed = writeBuffer(buffer, buffer_pos, all);
+                buffer_pos -= consumed;
+                // move not consumed bytes to the head
+                memmove(buffer, buffer+consumed, buffer_pos);
+            }
+        }
 
 
         // Splits the data up into individual parts - Returns the successfully consumed number of bytes
-        int writeBuffer(uint8_t* fileData, size_t len){
+        int writeBuffer(uint8_t* fileData, size_t len, bool all=true){
         	LOGD(__FUNCTION__);
             // split into
             size_t remaining_bytes = len;
-            buffer_pos = 0;
+            size_t pos = 0;
             while(true){
-                LOGI("-> mp3dec_decode_frame: %zu -> %zu ", buffer_pos, remaining_bytes);
-                int samples = minimp3::mp3dec_decode_frame(&mp3d, fileData+buffer_pos, remaining_bytes, pcm, &mp3dec_info);
-                buffer_pos+= mp3dec_info.frame_bytes;
+                // we keep the last frame(s) for the next call
+                if (!all && remaining_bytes < frame_lookahead){
+                    break;
+                }
+                LOGI("-> mp3dec_decode_frame: %zu -> %zu ", pos, remaining_bytes);
+                int samples = minimp3::mp3dec_decode_frame(&mp3d, fileData+pos, remaining_bytes, pcm, &mp3dec_info);
+                // no (complete) frame left in the data
+                if (mp3dec_info.frame_bytes==0){
+                    LOGD("-> no frame found in remaining_bytes: %zu", remaining_bytes);
+                    break;
+                }
+                pos += mp3dec_info.frame_bytes;
                 remaining_bytes-=mp3dec_info.frame_bytes;
                 if (samples>0){
                     provideResult(samples);
@@ -203,7 +227,7 @@ class MP3DecoderMini : public AudioDecoder  {
                     break;
                 }
             }
-            return buffer_pos;
+            return pos;
         }
 
         // Writes the data in small pieces: the api recommends to combine 16 frames before calling mp3dec_decode_frame
@@ -212,7 +236,8 @@ class MP3DecoderMini : public AudioDecoder  {
             // allocate buffer if it does not exist 
             if (buffer==nullptr){
                 LOGI("Allocating buffer with %zu bytes", buffer_len);
-                buffer = new uint8_t[buffer_len];
+                buffer = allocator->createArray<uint8_t>(buffer_len);
+                buffer_alloc_len = buffer_len;
             }
 
             // check allocated buffer
@@ -221,21 +246,27 @@ class MP3DecoderMini : public AudioDecoder  {
                 return 0;
             }
 
-            // add data to buffer
-            size_t write_len = std::min(len, buffer_len-buffer_pos);
-            memmove(buffer+buffer_pos, fileData, write_len);
-            buffer_pos += write_len;
-            // if buffer has been filled to 90% we flush
-            if (buffer_pos > buffer_len*90/100){
-                // calling mp3dec_decode_frame
-                flush();
-            }
-
-            // write reminder
-            if (len!=write_len){
-                int diff = len - write_len;
-                memmove(buffer, fileData+write_len, diff);
-                buffer_pos = diff;
+            // add data to buffer: the not consumed data is kept at the head of the buffer 
+            size_t processed = 0;
+            while (processed < len){
+                size_t write_len = std::min(len-processed, buffer_len-buffer_pos);
+                memmove(buffer+buffer_pos, fileData+processed, write_len);
+                buffer_pos += write_len;
+                processed += write_len;
+                // if buffer has been filled to 90% we flush
+                if (buffer_pos > buffer_len*90/100){
+                    // calling mp3dec_decode_frame
+                    decodeBuffer(false);
+                    // buffer is too small to keep the last frame
+                    if (buffer_pos==buffer_len){
+                        decodeBuffer(true);
+                    }
+                    // no frame found in a full buffer: we discard the data
+                    if (buffer_pos==buffer_len){
+                        LOGE("No mp3 frame found in %zu bytes", buffer_len);
+                        buffer_pos = 0;
+                    }
+                }
             }
             return len;
         }
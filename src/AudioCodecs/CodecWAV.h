@@ -267,7 +267,7 @@ class WAVDecoder : public AudioDecoder {
         }
 
         /// Defines the output Stream
-		void setOutputStream(Stream &out_stream){
+		void setOutputStream(Print &out_stream){
             this->out = &out_stream;
 		}
 
@@ -334,13 +334,15 @@ class WAVDecoder : public AudioDecoder {
                                 if (isValid){
                                     LOGI("isValid: %s", isValid ? "true":"false");
                                     audioBaseInfoSupport->setAudioInfo(bi);
-                                    // write prm data from first record
-                                    LOGI("WAVDecoder writing first sound data");
-                                    result = out->write(sound_ptr, len);
                                 } else {
                                     LOGE("isValid: %s", isValid ? "true":"false");
                                 }
                             }
+                            if (isValid){
+                                // write prm data from first record
+                                LOGI("WAVDecoder writing first sound data");
+                                result = out->write(sound_ptr, len);
+                            }
                         }
                     }
                 } else if (isValid)  {
@@ -39,7 +39,17 @@
 #define I2S_BUFFER_COUNT 5
 #define A2DP_BUFFER_SIZE 512
 #define A2DP_BUFFER_COUNT 50
+#define A2DP_LOCK_FREE true
+#define A2DP_STATIC_BUFFER false
 #define DEFAUT_ADC_PIN 34
+#define JITTER_BUFFER_SIZE (32 * 1024)
+#define JITTER_TARGET_LATENCY_MS 200
+#define JITTER_MIN_LATENCY_MS 50
+#define JITTER_MAX_LATENCY_MS 2000
+#define TEXT_BUFFER_SIZE 512
+#define RESAMPLE_BLOCK_FRAMES 256
+#define DECODER_SLICE_SIZE 32
+#define DECODER_MAX_FRAME_SIZE (1152 * 2 * 2)
 
 
 /**
@@ -48,7 +58,9 @@
  */
 #define PWM_BUFFER_SIZE 512
 #define PWM_BUFFERS 10
+#define PWM_LOCK_FREE false
 #define PWM_FREQUENCY 60000
+#define PWM_MAX_CHANNELS 16
 #if defined(ESP32)
 #define PWM_START_PIN 4
 #elif defined(__arm__)
@@ -70,6 +82,21 @@
 #define USE_A2DP
 #endif
 
+// Lock free buffers need std::atomic which is not available on AVR
+#ifndef __AVR__
+#define USE_ATOMIC
+#endif
+
+// On Linux we can map the memory of a ring buffer twice, so that we do not need to handle the wrap around
+#if defined(__linux__) && !defined(NO_MIRRORED_BUFFER)
+#define USE_MIRRORED_BUFFER
+#endif
+
+// Set to true to collect the fill level, watermarks, underruns and overruns of all buffers (see BufferStats)
+#ifndef USE_BUFFER_STATS
+#define USE_BUFFER_STATS false
+#endif
+
 
 /**
  * ------------------------------------------------------------------------- 
@@ -8,60 +8,42 @@
 namespace audio_tools {
 
 /**
- * @brief ESP8266Audio AudioOutput class which stores the data in a temporary buffer. 
- * The buffer can be consumed e.g. by a callback function by calling read();
+ * @brief ESP8266Audio AudioOutput class which stores the data in the buffers of a CallbackStream. 
+ * The buffers can be consumed e.g. by a callback function by calling read() or with the zero copy api 
+ * getReadBuffer() and release();
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class AudioOutputWithCallback : public AudioOutput, public BufferedStream {
+class AudioOutputWithCallback : public AudioOutput, public CallbackStream<Channels> {
     public:
         // Default constructor
-        AudioOutputWithCallback(int bufferSize, int bufferCount ):BufferedStream(bufferSize) {
-            callback_buffer_ptr = new NBuffer<Channels>(bufferSize, bufferCount);
-        }
-
-        virtual ~AudioOutputWithCallback() {    
-            delete callback_buffer_ptr;
+        AudioOutputWithCallback(int bufferSize, int bufferCount, UnderrunMode mode=UNDERRUN_SILENCE ):CallbackStream<Channels>(bufferSize, bufferCount, mode, 1) {
         }
 
         /// Activates the output
         virtual bool begin() { 
-            active = true;
-            return true;
+            return CallbackStream<Channels>::begin();
         }
 
-        /// puts the sample into a buffer
+        /// puts the sample directly into the actual buffer
         virtual bool ConsumeSample(int16_t sample[2]) {
-            Channels c;
-            c.channel1 = sample[0];
-            c.channel2 = sample[1];
-            return callback_buffer_ptr->write(c);
+            BufferSpan<Channels> span = getWriteBuffer();
+            if (!span) return false;
+            span.data[0].channel1 = sample[0];
+            span.data[0].channel2 = sample[1];
+            commit(1);
+            return true;
         };
         
         /// stops the processing
         virtual bool stop() {
-            active = false;
-            return true;
+            return CallbackStream<Channels>::stop();
         };
 
-        /// Provides the data from the internal buffer to the callback
+        /// Provides the data from the internal buffers to the callback: an underrun is handled according to the UnderrunMode
         size_t read(Channels *src, size_t len){
-            return active ? this->callback_buffer_ptr->readArray(src, len) : 0;
+            return readSamples(src, len);
         }
-
-    
-  protected:
-        NBuffer<Channels> *callback_buffer_ptr;
-        bool active;
-
-        virtual size_t writeExt(const uint8_t* data, size_t len) {    
-            return callback_buffer_ptr->writeArray((Channels*)data, len/sizeof(Channels));
-        }
-
-        virtual size_t readExt( uint8_t *data, size_t len) { 
-            return callback_buffer_ptr->readArray((Channels*)data, len/sizeof(Channels));;
-        }
-
 };
 
 }
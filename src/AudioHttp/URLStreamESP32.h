@@ -13,12 +13,12 @@ namespace audio_tools {
  */
 class URLStream : public Stream {
     public:
-        URLStream(int readBufferSize=DEFAULT_BUFFER_SIZE){
-            read_buffer = new uint8_t[readBufferSize];
+        URLStream(int readBufferSize=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
+            allocateBuffer(readBufferSize, allocator);
         }
 
         ~URLStream(){
-            delete[] read_buffer;
+            allocator->removeArray(read_buffer, read_buffer_size);
             end();
         }
 
@@ -102,9 +102,19 @@ class URLStream : public Stream {
         long total_read;
         // buffered read
         uint8_t *read_buffer;
-        uint16_t read_buffer_size;
-        uint16_t read_pos;
-        uint16_t read_size;
+        size_t read_buffer_size;
+        Allocator *allocator;
+        size_t read_pos;
+        size_t read_size;
+
+        void allocateBuffer(int size, Allocator &allocator){
+            this->allocator = &allocator;
+            read_buffer_size = size;
+            read_buffer = allocator.createArray<uint8_t>(size);
+            if (read_buffer==nullptr){
+                read_buffer_size = 0;
+            }
+        }
 
         inline void fillBuffer() {
             if (isEOS()){
@@ -35,6 +35,7 @@ struct PWMConfig {
     uint8_t bits_per_sample = 16;
     uint16_t buffer_size = PWM_BUFFER_SIZE;
     uint8_t buffers = PWM_BUFFERS; 
+    bool lock_free = PWM_LOCK_FREE; // use a lock free ring buffer between write() and the timer
 
     // additinal info
     uint32_t pwm_frequency = PWM_FREQUENCY;  // audable range is from 20 to 20,000Hz (not used by ESP32)
@@ -64,6 +65,7 @@ struct PWMConfig {
         LOGI("channels: %d", channels);
         LOGI("bits_per_sample: %d", bits_per_sample);
         LOGI("buffer_size: %d", buffer_size);
+        LOGI("lock_free: %s", lock_free ? "true" : "false");
         LOGI("pwm_frequency: %d", pwm_frequency);
         //LOGI("resolution: %d", resolution);
         //LOGI("timer_id: %d", timer_id);
@@ -80,7 +82,7 @@ struct PWMConfig {
  * @brief Common functionality for PWM output
  * 
  */
-class PWMAudioStreamBase : public Stream {
+class PWMAudioStreamBase : public AudioStream {
     public:
         ~PWMAudioStreamBase(){
             if (is_timer_started){
@@ -124,10 +126,14 @@ class PWMAudioStreamBase : public Stream {
                 LOGE("Only max %d channels are supported!",maxChannels());
                 return false;
             }             
+            if (config.bits_per_sample>32 || config.channels * config.bits_per_sample / 8 > (int) sizeof(frame_data)){
+                LOGE("Unsupported bits_per_sample: %d", config.bits_per_sample);
+                return false;
+            }
             // allocate new buffer
             if (buffer==nullptr) {
                 LOGI("Allocating new buffer %d * %d bytes",config.buffers, config.buffer_size);
-                buffer = new NBuffer<uint8_t>(config.buffer_size, config.buffers);
+                buffer = createBuffer(config);
             } else {
                 buffer->reset();
             }
@@ -136,6 +142,7 @@ class PWMAudioStreamBase : public Stream {
                 LOGE("not enough memory to allocate the buffers");
                 return false;
             }
+            frames.begin(*buffer, audioInfo());
 
             logConfig();
             setupPWM();
@@ -151,10 +158,11 @@ class PWMAudioStreamBase : public Stream {
             if (user_callback==nullptr) {
                 if (buffer==nullptr) {
                     LOGI("->Allocating new buffer %d * %d bytes",audio_config.buffers, audio_config.buffer_size);
-                    buffer = new NBuffer<uint8_t>(audio_config.buffer_size, audio_config.buffers);
+                    buffer = createBuffer(audio_config);
                 } else {
                     buffer->reset();
                 }
+                frames.begin(*buffer, audioInfo());
             }
             // initialize if necessary
             if (!is_timer_started){
@@ -182,27 +190,13 @@ class PWMAudioStreamBase : public Stream {
         }
 
 
-        // not supported
+        // not supported: this is an output only
         virtual int available() {
-            LOGE("not supported");
             return 0;
         }
 
-        // not supported
-        virtual int read(){
-            LOGE("not supported");
-            return -1;
-        }
-
-        // not supported
-        virtual int peek() {
-            LOGE("not supported");
-            return -1;
-        }
-
-        // not supported
-        virtual size_t readBytes(char *buffer, size_t length){
-            LOGE("not supported");
+        // not supported: this is an output only
+        virtual size_t readBytes(uint8_t *buffer, size_t length){
             return 0;
         }
 
@@ -213,18 +207,9 @@ class PWMAudioStreamBase : public Stream {
         virtual void flush() { 
         }
 
-        // blocking write for a single byte
-        virtual size_t write(uint8_t value) {
-            size_t result = 0;
-            if (buffer->availableToWrite()>1){
-                result = buffer->write(value);
-                startTimer();
-            }
-            return result;
-        }
-
-        // blocking write for an array: we expect a singed value and convert it into a unsigned 
+        // write for an array which is limited to availableForWrite(): we expect a singed value and convert it into a unsigned 
         virtual size_t write(const uint8_t *wrt_buffer, size_t size){
+            if (buffer==nullptr) return 0;
             size_t available = min((size_t)availableForWrite(),size);
             LOGD("write: %lu bytes -> %lu", size, available);
             size_t result = buffer->writeArray(wrt_buffer, available);
@@ -236,6 +221,22 @@ class PWMAudioStreamBase : public Stream {
             return result;
         }
 
+        /// Defines the audio format which is used by the next begin()
+        virtual void setAudioInfo(AudioBaseInfo info) {
+            audio_config.sample_rate = info.sample_rate;
+            audio_config.channels = info.channels;
+            audio_config.bits_per_sample = info.bits_per_sample;
+        }
+
+        /// Provides the audio format of the actual configuration
+        virtual AudioBaseInfo audioInfo() {
+            AudioBaseInfo info;
+            info.sample_rate = audio_config.sample_rate;
+            info.channels = audio_config.channels;
+            info.bits_per_sample = audio_config.bits_per_sample;
+            return info;
+        }
+
         // When the timer does not have enough data we increase the underflow_count;
         uint32_t underflowsPerSecond(){
             return underflow_per_second;
@@ -250,7 +251,8 @@ class PWMAudioStreamBase : public Stream {
 
     protected:
         PWMConfig audio_config;
-        NBuffer<uint8_t> *buffer = nullptr;
+        BaseBuffer<uint8_t> *buffer = nullptr;
+        FrameBuffer frames;
         PWMCallbackType user_callback = nullptr;
         uint32_t underflow_count = 0;
         uint32_t underflow_per_second = 0;
@@ -258,10 +260,13 @@ class PWMAudioStreamBase : public Stream {
         uint32_t frames_per_second = 0;
         uint64_t time_1_sec;
         bool is_timer_started = false;
+        // the next frame: used by the timer, so we do not want to allocate it on the stack
+        uint8_t frame_data[PWM_MAX_CHANNELS * 4];
+        int16_t callback_data[PWM_MAX_CHANNELS];
 
         virtual void setupPWM() = 0;
         virtual void setupTimer() = 0;
-        virtual int maxChannels() = 0;
+        virtual int maxChannels() = 0;     // max PWM_MAX_CHANNELS
         virtual int maxOutputValue() = 0;
 
 
@@ -288,13 +293,25 @@ class PWMAudioStreamBase : public Stream {
             audio_config.logConfig();
         }
 
+        /// allocates the buffer which is used between write() and the timer
+        BaseBuffer<uint8_t> *createBuffer(PWMConfig &cfg){
+#ifdef USE_ATOMIC
+            if (cfg.lock_free){
+                return new AtomicRingBuffer<uint8_t>(cfg.buffer_size * cfg.buffers);
+            }
+#endif
+            // make sure that a frame never spans 2 buffers
+            int frame_size = cfg.channels * cfg.bits_per_sample / 8;
+            int buffer_size = frame_size > 0 ? cfg.buffer_size - (cfg.buffer_size % frame_size) : cfg.buffer_size;
+            return new NBuffer<uint8_t>(buffer_size, cfg.buffers);
+        }
+
         void playNextFrameCallback(){
 	 		//LOGD(__FUNCTION__);
             uint8_t channels = audio_config.channels;
-            int16_t data[channels];
-            if (user_callback(channels, data)){
+            if (user_callback(channels, callback_data)){
                 for (uint8_t j=0;j<audio_config.channels;j++){
-                    int value  = map(data[j], -maxValue(16), maxValue(16), 0, 255); 
+                    int value  = map(callback_data[j], -maxValue(16), maxValue(16), 0, 255); 
                     pwmWrite(j, value);
                 }
                 updateStatistics();                
@@ -302,14 +319,14 @@ class PWMAudioStreamBase : public Stream {
         }
 
 
-        /// writes the next frame to the output pins 
+        /// writes the next frame to the output pins: we read only full frames
         void playNextFrameStream(){
             if (is_timer_started){
 	 		    //LOGD(__FUNCTION__);
-                int required = (audio_config.bits_per_sample / 8) * audio_config.channels;
-                if (buffer->available() >= required){
+                int sample_size = audio_config.bits_per_sample / 8;
+                if (frames.readFrames(frame_data, 1)==1){
                     for (int j=0;j<audio_config.channels;j++){
-                        int value  = nextValue();
+                        int value  = scaledValue(frame_data + (j * sample_size));
                         pwmWrite(j, value);
                     }
                 } else {
@@ -331,40 +348,29 @@ class PWMAudioStreamBase : public Stream {
         }
 
 
-        /// determines the next scaled value
-        virtual int nextValue() {
-            int result;
+        /// determines the scaled value of the indicated sample
+        virtual int scaledValue(const uint8_t *sample) {
+            int result = 0;
             switch(audio_config.bits_per_sample ){
                 case 8: {
-                    int16_t value = buffer->read();
-                    if (value<0){
-                        LOGE("Could not read full data");
-                        value = 0;
-                    }
+                    int8_t value = (int8_t) sample[0];
                     result = map(value, -maxValue(8), maxValue(8), 0, maxOutputValue());
                     break;
                 }
                 case 16: {
                     int16_t value;
-                    if (buffer->readArray((uint8_t*)&value,2)!=2){
-                        LOGE("Could not read full data");
-                    }
+                    memcpy(&value, sample, 2);
                     result = map(value, -maxValue(16), maxValue(16), 0, maxOutputValue());
                     break;
                 }
                 case 24: {
-                    int24_t value;
-                    if (buffer->readArray((uint8_t*)&value,3)!=3){
-                        LOGE("Could not read full data");
-                    }
+                    int24_t value((uint8_t*)sample);
                     result = map((int32_t)value, -maxValue(24), maxValue(24), 0, maxOutputValue());
                     break;
                 }
                 case 32: {
                     int32_t value;
-                    if (buffer->readArray((uint8_t*)&value,4)!=4){
-                        LOGE("Could not read full data");
-                    }
+                    memcpy(&value, sample, 4);
                     result = map(value, -maxValue(32), maxValue(32), 0, maxOutputValue());
                     break;
                 }
@@ -9,6 +9,7 @@
  */
 #include "AudioConfig.h"
 #include "AudioTools/AudioTypes.h"
+#include "AudioTools/Allocator.h"
 #include "AudioTools/Buffers.h"
 #include "AudioTools/Converter.h"
 #include "AudioTools/MusicalNotes.h"
@@ -19,8 +20,13 @@
 #include "AudioTools/TimerAlarmRepeating.h"
 #include "AudioTools/Streams.h"
 #include "AudioTools/AudioCopy.h"
+#include "AudioTools/AudioPipeline.h"
+#include "AudioTools/AudioMixer.h"
+#include "AudioTools/FormatConverter.h"
+#include "AudioTools/ResampleStream.h"
 #include "AudioTools/AudioPWM.h"
 #include "AudioTools/PortAudioStream.h"
+#include "AudioTools/MappedFileStream.h"
 
 #include "AudioCodecs/CodecWAV.h"
 //#include "AudioCodecs/CodecMP3Mini.h"
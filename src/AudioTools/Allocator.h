@@ -0,0 +1,202 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#include <stdlib.h>
+#include <stddef.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Memory allocator which is used by the buffers and streams. The default implementation
+ * is using the heap. Subclasses can e.g. provide the memory from a preallocated pool.
+ * We keep track of the usage, the peak usage and the allocation failures. The arrays must only
+ * contain simple data types (no constructors or destructors are called)!
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Allocator {
+    public:
+        virtual ~Allocator() = default;
+
+        /// Allocates an array of len entries: returns nullptr if this was not possible
+        template <typename T>
+        T* createArray(int len){
+            return (T*) allocate(sizeof(T) * len);
+        }
+
+        /// Releases an array that was created with createArray()
+        template <typename T>
+        void removeArray(T* array, int len){
+            if (array!=nullptr){
+                release(array, sizeof(T) * len);
+            }
+        }
+
+        /// Allocates the requested number of bytes
+        void* allocate(size_t size){
+            void* result = doAllocate(size);
+            if (result==nullptr){
+                failure_count++;
+                LOGE("Allocation of %u bytes failed", (unsigned)size);
+            } else {
+                allocation_count++;
+                current_usage += size;
+                if (current_usage > peak_usage){
+                    peak_usage = current_usage;
+                }
+            }
+            return result;
+        }
+
+        /// Releases the memory which was allocated with the indicated size
+        void release(void* memory, size_t size){
+            if (memory!=nullptr){
+                doRelease(memory, size);
+                current_usage -= size;
+            }
+        }
+
+        /// Provides the number of bytes that are currently allocated
+        size_t usage() {
+            return current_usage;
+        }
+
+        /// Provides the max number of bytes that were allocated at the same time
+        size_t peakUsage() {
+            return peak_usage;
+        }
+
+        /// Provides the number of successful allocations
+        uint32_t allocations() {
+            return allocation_count;
+        }
+
+        /// Provides the number of failed allocations
+        uint32_t failures() {
+            return failure_count;
+        }
+
+    protected:
+        size_t current_usage = 0;
+        size_t peak_usage = 0;
+        uint32_t allocation_count = 0;
+        uint32_t failure_count = 0;
+
+        virtual void* doAllocate(size_t size) {
+            return malloc(size);
+        }
+
+        virtual void doRelease(void* memory, size_t size) {
+            free(memory);
+        }
+};
+
+/// Pointer to the allocator which is used when no allocator has been defined explicitly: per default we use the heap
+inline Allocator* &defaultAllocatorPtr() {
+    static Allocator heap;
+    static Allocator *ptr = &heap;
+    return ptr;
+}
+
+/// Provides the allocator which is used when no allocator has been defined explicitly
+inline Allocator &defaultAllocator() {
+    return *defaultAllocatorPtr();
+}
+
+/// Defines the allocator which is used by all buffers and streams that are created afterwards
+inline void setDefaultAllocator(Allocator &allocator) {
+    defaultAllocatorPtr() = &allocator;
+}
+
+/**
+ * @brief Allocator which provides fixed size blocks from a memory area that is allocated only once:
+ * this prevents the fragmentation of the heap e.g. when streams are recreated. Requests which do not
+ * fit into a block (or if all blocks are in use) are forwarded to the parent allocator if fallback
+ * is active. Allocating and releasing a block is O(1). The block size is rounded up, so that all blocks are 
+ * aligned like the memory provided by malloc. This class is not thread safe.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BufferPool : public Allocator {
+    public:
+        BufferPool(size_t blockSize, int blockCount, bool fallback=true, Allocator &parent=defaultAllocator()){
+            this->block_size = alignedSize(blockSize);
+            this->block_count = blockCount;
+            this->fallback = fallback;
+            this->parent = &parent;
+            memory = parent.createArray<uint8_t>(block_size * block_count);
+            free_blocks = parent.createArray<int>(block_count);
+            if (memory==nullptr || free_blocks==nullptr){
+                LOGE("BufferPool could not allocate %d blocks of %u bytes", blockCount, (unsigned)blockSize);
+                parent.removeArray(memory, block_size * block_count);
+                parent.removeArray(free_blocks, block_count);
+                memory = nullptr;
+                free_blocks = nullptr;
+                block_count = 0;
+            }
+            for (int j=0;j<block_count;j++){
+                free_blocks[j] = j;
+            }
+            free_count = block_count;
+        }
+
+        ~BufferPool(){
+            parent->removeArray(memory, block_size * block_count);
+            parent->removeArray(free_blocks, block_count);
+        }
+
+        /// Provides the (aligned) size of a block
+        size_t blockSize() {
+            return block_size;
+        }
+
+        /// Provides the number of unused blocks
+        int freeBlocks() {
+            return free_count;
+        }
+
+        /// Provides the number of requests that could not be served from the pool
+        uint32_t poolMisses() {
+            return pool_misses;
+        }
+
+    protected:
+        Allocator *parent;
+        uint8_t *memory = nullptr;
+        int *free_blocks = nullptr;
+        size_t block_size;
+        int block_count;
+        int free_count = 0;
+        bool fallback;
+        uint32_t pool_misses = 0;
+
+        virtual void* doAllocate(size_t size) {
+            if (size <= block_size && free_count > 0){
+                int block = free_blocks[--free_count];
+                return memory + (block * block_size);
+            }
+            pool_misses++;
+            return fallback ? parent->allocate(size) : nullptr;
+        }
+
+        virtual void doRelease(void* ptr, size_t size) {
+            uint8_t *block_ptr = (uint8_t*) ptr;
+            if (isInPool(block_ptr)){
+                free_blocks[free_count++] = (block_ptr - memory) / block_size;
+            } else {
+                parent->release(ptr, size);
+            }
+        }
+
+        static size_t alignedSize(size_t size) {
+            const size_t align = alignof(max_align_t);
+            return (size + align - 1) / align * align;
+        }
+
+        bool isInPool(uint8_t *ptr) {
+            return memory!=nullptr && ptr >= memory && ptr < memory + (block_size * block_count);
+        }
+};
+
+}
@@ -17,23 +17,22 @@ namespace audio_tools {
 template <class T>
 class StreamCopyT {
     public:
-        StreamCopyT(Print &to, Stream &from, int buffer_size=DEFAULT_BUFFER_SIZE){
+        StreamCopyT(Print &to, Stream &from, int buffer_size=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
             LOGD("StreamCopyT")
             begin(to, from);
-            this->buffer_size = buffer_size;
-            buffer = new uint8_t[buffer_size];
-            if (buffer==nullptr){
-                LOGE("Could not allocate enough memory for StreamCopy: %d bytes", buffer_size);
-            }
+            allocateBuffer(buffer_size, allocator);
         }
 
-        StreamCopyT(int buffer_size=DEFAULT_BUFFER_SIZE){
+        /// If the output is an AudioStream we never write more than its availableForWrite()
+        StreamCopyT(AudioStream &to, Stream &from, int buffer_size=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
             LOGD("StreamCopyT")
-            this->buffer_size = buffer_size;
-            buffer = new uint8_t[buffer_size];
-            if (buffer==nullptr){
-                LOGE("Could not allocate enough memory for StreamCopy: %d bytes", buffer_size);
-            }
+            begin(to, from);
+            allocateBuffer(buffer_size, allocator);
+        }
+
+        StreamCopyT(int buffer_size=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
+            LOGD("StreamCopyT")
+            allocateBuffer(buffer_size, allocator);
         }
 
         void begin(){            
@@ -43,17 +42,35 @@ class StreamCopyT {
         void begin(Print &to, Stream &from){
             this->from = &from;
             this->to = &to;
+            this->to_audio = nullptr;
+            this->from_data = nullptr;
+        }
+
+        /// assign a new AudioStream output and input stream: the copy is sized with availableForWrite(), so it does not block 
+        void begin(AudioStream &to, Stream &from){
+            begin((Print&)to, from);
+            this->to_audio = &to;
+        }
+
+        /// assign a new output and a memory area (e.g. MappedFileStream::data()) as source: the data is written w/o copying it
+        void begin(Print &to, const uint8_t *data, size_t size){
+            this->from = nullptr;
+            this->to = &to;
+            this->to_audio = nullptr;
+            this->from_data = data;
+            this->from_size = size;
+            this->from_pos = 0;
         }
 
         ~StreamCopyT(){
-            delete[] buffer;
+            allocator->removeArray(buffer, buffer_size);
         }
 
         // copies the data from one channel from the source to 2 channels on the destination - the result is in bytes
          size_t copy(){
             size_t result = 0;
             size_t delayCount = 0;
-            size_t len = available();
+            size_t len = writable(available());
             size_t bytes_to_read=0;
             size_t bytes_read=0; 
 
@@ -61,8 +78,15 @@ class StreamCopyT {
                 bytes_to_read = min(len, static_cast<size_t>(buffer_size));
                 size_t samples = bytes_to_read / sizeof(T);
                 bytes_to_read = samples * sizeof(T);
-                bytes_read = from->readBytes(buffer, bytes_to_read);
-                result = write(bytes_read, delayCount);
+                if (from_data!=nullptr){
+                    // zero copy: we write directly from the source memory
+                    bytes_read = bytes_to_read;
+                    result = write(from_data + from_pos, bytes_read, delayCount);
+                    from_pos += result;
+                } else {
+                    bytes_read = from->readBytes(buffer, bytes_to_read);
+                    result = write(buffer, bytes_read, delayCount);
+                }
             } 
             LOGI("StreamCopy::copy %zu -> %zu -> %zu bytes - in %zu hops", bytes_to_read, bytes_read, result, delayCount);
             return result;
@@ -74,8 +98,8 @@ class StreamCopyT {
             size_t result = 0;
             size_t delayCount = 0;
             size_t bytes_read;
-            size_t len = available();
-            size_t bytes_to_read;
+            size_t len = writable(available() * 2) / 2;
+            size_t bytes_to_read = 0;
             
             if (len>0){
                 bytes_to_read = min(len, static_cast<size_t>(buffer_size / 2));
@@ -83,7 +107,7 @@ class StreamCopyT {
                 bytes_to_read = samples * sizeof(T);
 
                 T temp_data[samples];
-                bytes_read = from->readBytes((uint8_t*)temp_data, bytes_to_read);
+                bytes_read = readBytes((uint8_t*)temp_data, bytes_to_read);
 
                 T* bufferT = (T*) buffer;
                 for (int j=0;j<samples;j++){
@@ -92,7 +116,7 @@ class StreamCopyT {
                     *bufferT = temp_data[j];
                     bufferT++;
                 }
-                result = write(samples * sizeof(T)*2, delayCount);
+                result = write(buffer, samples * sizeof(T)*2, delayCount);
             } 
             LOGI("StreamCopy::copy %zu -> %zu bytes - in %d hops", bytes_to_read, result, delayCount);
             return result;
@@ -100,7 +124,7 @@ class StreamCopyT {
 
         /// available bytes in the data source
         int available() {
-            return from->available();
+            return from_data!=nullptr ? from_size - from_pos : from->available();
         }
 
         /// copies all data
@@ -112,17 +136,52 @@ class StreamCopyT {
         }
 
     protected:
-        Stream *from;
-        Print *to;
+        Stream *from = nullptr;
+        Print *to = nullptr;
+        AudioStream *to_audio = nullptr;
+        const uint8_t *from_data = nullptr;
+        size_t from_size = 0;
+        size_t from_pos = 0;
         uint8_t *buffer;
         int buffer_size;
+        Allocator *allocator;
+
+        void allocateBuffer(int size, Allocator &allocator){
+            this->allocator = &allocator;
+            this->buffer_size = size;
+            buffer = allocator.createArray<uint8_t>(buffer_size);
+            if (buffer==nullptr){
+                LOGE("Could not allocate enough memory for StreamCopy: %d bytes", buffer_size);
+                buffer_size = 0;
+            }
+        }
+
+        /// limits the indicated number of bytes to the space that is available in an AudioStream output
+        size_t writable(size_t len){
+            if (to_audio!=nullptr){
+                int space = to_audio->availableForWrite();
+                len = space > 0 ? min(len, (size_t) space) : 0;
+            }
+            return len;
+        }
+
+        /// reads from the source stream or memory
+        size_t readBytes(uint8_t *data, size_t len){
+            if (from_data!=nullptr){
+                len = min(len, from_size - from_pos);
+                memcpy(data, from_data + from_pos, len);
+                from_pos += len;
+                return len;
+            }
+            return from->readBytes(data, len);
+        }
 
         // blocking write - until everything is processed
-        size_t write(size_t len, size_t &delayCount ){
+        size_t write(const uint8_t *data, size_t len, size_t &delayCount ){
             size_t total = 0;
             int retry = 0;
             while(total<len){
-                size_t written = to->write(buffer+total, len-total);
+                size_t written = to->write(data+total, len-total);
                 total += written;
                 delayCount++;
 
@@ -147,27 +206,49 @@ class StreamCopyT {
  */
 class StreamCopy : public StreamCopyT<uint8_t> {
     public:
-        StreamCopy(int buffer_size=DEFAULT_BUFFER_SIZE): StreamCopyT<uint8_t>(buffer_size) {            
+        StreamCopy(int buffer_size=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()): StreamCopyT<uint8_t>(buffer_size, allocator) {            
             LOGD("StreamCopy")
         }
 
-        StreamCopy(Print &to, Stream &from, int buffer_size=DEFAULT_BUFFER_SIZE) : StreamCopyT<uint8_t>(to, from, buffer_size){
+        StreamCopy(Print &to, Stream &from, int buffer_size=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()) : StreamCopyT<uint8_t>(to, from, buffer_size, allocator){
             LOGD("StreamCopy")
         }
 
-        /// copies a buffer length of data and applies the converter
+        StreamCopy(AudioStream &to, Stream &from, int buffer_size=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()) : StreamCopyT<uint8_t>(to, from, buffer_size, allocator){
+            LOGD("StreamCopy")
+        }
+
+        /// copies a buffer length of stereo data and applies the converter: the converter only gets full frames. An incomplete
+        /// frame at the end is kept and completed with the next copy.
         template<typename T>
         size_t copy(BaseConverter<T> &converter) {
-            size_t result = available();
+            return copy(converter, 2);
+        }
+
+        /// copies a buffer length of interleaved data with the indicated number of channels and applies the converter
+        template<typename T>
+        size_t copy(MultiChannelConverter<T> &converter, int channels) {
+            size_t result = 0;
             size_t delayCount = 0;
+            const int frame_size = sizeof(T)*channels;
+            size_t len = available();
 
-            BaseConverter<T> *coverter_ptr = &converter;
-            if (result>0){
-                size_t bytes_to_read = min(result, static_cast<size_t>(buffer_size) );
-                result = from->readBytes(buffer, bytes_to_read);
-                // convert to pointer to array of 2
-                coverter_ptr->convert((T(*)[2])buffer,  result / (sizeof(T)*2) );
-                write(result, delayCount);
+            MultiChannelConverter<T> *coverter_ptr = &converter;
+            // the pending frame is written together with the new data
+            size_t space = writable(buffer_size);
+            len = space > (size_t) frame_pending ? min(len, space - frame_pending) : 0;
+            if (len>0 && buffer_size>=frame_size){
+                size_t bytes_to_read = min(len, static_cast<size_t>(buffer_size - frame_pending) );
+                size_t total = frame_pending + readBytes(buffer+frame_pending, bytes_to_read);
+                size_t frames = total / frame_size;
+                size_t frame_bytes = frames * frame_size;
+                coverter_ptr->convertBlock((T*)buffer, frames, channels);
+                result = write(buffer, frame_bytes, delayCount);
+                // keep the incomplete frame
+                frame_pending = total - frame_bytes;
+                if (frame_pending>0){
+                    memmove(buffer, buffer+frame_bytes, frame_pending);
+                }
             } 
 
             LOGI("StreamCopy::copy %zu bytes - in %zu hops", result, delayCount);
@@ -179,9 +260,11 @@ class StreamCopy : public StreamCopyT<uint8_t> {
         }
 
         int available() {
-            return from->available();
+            return StreamCopyT<uint8_t>::available();
         }
 
+    protected:
+        int frame_pending = 0;
 
 };
 
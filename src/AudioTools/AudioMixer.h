@@ -0,0 +1,318 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/Allocator.h"
+#include "AudioTools/Buffers.h"
+#include "AudioTools/Vector.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Mixes 16 bit samples: each input is multiplied with its Q15 gain (32768 = 1.0) and added in int32,
+ * so that the sum can only be clipped once when it is stored. The unity gain just adds the samples. We use SSE2 or NEON if the target supports it
+ * and a scalar implementation otherwise: all implementations provide identical results.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MixerKernel {
+    public:
+        /// acc[j] += (in[j] * gain) >> 15 with -32768 <= gain <= 32768
+        static void add(int32_t *acc, const int16_t *in, int32_t gain, size_t samples){
+            if (gain==32768){
+                addUnity(acc, in, samples);
+                return;
+            }
+            size_t j = 0;
+#if defined(__SSE2__)
+            __m128i g = _mm_set1_epi16((int16_t)gain);
+            for (; j+8<=samples; j+=8){
+                __m128i x = _mm_loadu_si128((const __m128i*)(in+j));
+                __m128i lo = _mm_mullo_epi16(x, g);
+                __m128i hi = _mm_mulhi_epi16(x, g);
+                __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+                __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+                __m128i *a = (__m128i*)(acc+j);
+                _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), p0));
+                _mm_storeu_si128(a+1, _mm_add_epi32(_mm_loadu_si128(a+1), p1));
+            }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            for (; j+8<=samples; j+=8){
+                int16x8_t x = vld1q_s16(in+j);
+                int32x4_t p0 = vmull_n_s16(vget_low_s16(x), gain);
+                int32x4_t p1 = vmull_n_s16(vget_high_s16(x), gain);
+                vst1q_s32(acc+j, vsraq_n_s32(vld1q_s32(acc+j), p0, 15));
+                vst1q_s32(acc+j+4, vsraq_n_s32(vld1q_s32(acc+j+4), p1, 15));
+            }
+#endif
+            addScalar(acc+j, in+j, gain, samples-j);
+        }
+
+        /// acc[j] += in[j]
+        static void addUnity(int32_t *acc, const int16_t *in, size_t samples){
+            size_t j = 0;
+#if defined(__SSE2__)
+            for (; j+8<=samples; j+=8){
+                __m128i x = _mm_loadu_si128((const __m128i*)(in+j));
+                __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+                __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+                __m128i *a = (__m128i*)(acc+j);
+                _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), p0));
+                _mm_storeu_si128(a+1, _mm_add_epi32(_mm_loadu_si128(a+1), p1));
+            }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            for (; j+8<=samples; j+=8){
+                int16x8_t x = vld1q_s16(in+j);
+                vst1q_s32(acc+j, vaddw_s16(vld1q_s32(acc+j), vget_low_s16(x)));
+                vst1q_s32(acc+j+4, vaddw_s16(vld1q_s32(acc+j+4), vget_high_s16(x)));
+            }
+#endif
+            addScalar(acc+j, in+j, 32768, samples-j);
+        }
+
+        /// out[j] = acc[j] saturated to int16
+        static void store(int16_t *out, const int32_t *acc, size_t samples){
+            size_t j = 0;
+#if defined(__SSE2__)
+            for (; j+8<=samples; j+=8){
+                __m128i a0 = _mm_loadu_si128((const __m128i*)(acc+j));
+                __m128i a1 = _mm_loadu_si128((const __m128i*)(acc+j+4));
+                _mm_storeu_si128((__m128i*)(out+j), _mm_packs_epi32(a0, a1));
+            }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            for (; j+8<=samples; j+=8){
+                int16x4_t lo = vqmovn_s32(vld1q_s32(acc+j));
+                int16x4_t hi = vqmovn_s32(vld1q_s32(acc+j+4));
+                vst1q_s16(out+j, vcombine_s16(lo, hi));
+            }
+#endif
+            storeScalar(out+j, acc+j, samples-j);
+        }
+
+        /// Scalar implementation of add()
+        static void addScalar(int32_t *acc, const int16_t *in, int32_t gain, size_t samples){
+            for (size_t j=0;j<samples;j++){
+                acc[j] += ((int32_t)in[j] * gain) >> 15;
+            }
+        }
+
+        /// Scalar implementation of store()
+        static void storeScalar(int16_t *out, const int32_t *acc, size_t samples){
+            for (size_t j=0;j<samples;j++){
+                int32_t value = acc[j];
+                out[j] = value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+            }
+        }
+};
+
+/**
+ * @brief Stream which mixes the 16 bit PCM data of multiple input streams: all inputs must have the same
+ * sample rate and the number of channels defined with setAudioInfo(). Each input has its own gain. We only mix 
+ * the data which is available in all active inputs, so that they stay aligned when an input is late. After an input
+ * has been marked with endOfInput() we use silence for its missing part, so the result has the length of the longest 
+ * input. We only mix complete frames: incomplete frames are kept until the input provides the rest.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioMixer : public AudioStream {
+    public:
+        /// bufferSize is the max number of bytes which are mixed in one step
+        AudioMixer(int bufferSize=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
+            this->allocator = &allocator;
+            audio_info.channels = DEFAULT_CHANNELS;
+            audio_info.bits_per_sample = 16;
+            buffer_samples = bufferSize / sizeof(int16_t);
+            acc = allocator.createArray<int32_t>(buffer_samples);
+            samples = allocator.createArray<int16_t>(buffer_samples);
+            if (acc==nullptr || samples==nullptr){
+                releaseBuffers();
+            }
+        }
+
+        ~AudioMixer(){
+            releaseBuffers();
+        }
+
+        /// Adds an input with the indicated gain (0.0 - 1.0)
+        void add(Stream &in, float gain=1.0){
+            Input input;
+            input.in = &in;
+            inputs.push_back(input);
+            partials.resize(inputs.size() * frameSize());
+            setGain(inputs.size()-1, gain);
+        }
+
+        /// Marks the indicated input as ended: from now on its missing data is replaced by silence
+        void endOfInput(int idx){
+            inputs[idx].ended = true;
+        }
+
+        /// Returns true if the indicated input was marked with endOfInput()
+        bool isEnded(int idx) {
+            return inputs[idx].ended;
+        }
+
+        /// Defines the gain (0.0 - 1.0) of the indicated input
+        void setGain(int idx, float gain){
+            if (gain<0.0) gain = 0.0;
+            if (gain>1.0) gain = 1.0;
+            setGainQ15(idx, gain * 32768.0 + 0.5);
+        }
+
+        /// Defines the gain as Q15 value (32768 = 1.0) of the indicated input
+        void setGainQ15(int idx, int32_t gain){
+            if (gain<-32768) gain = -32768;
+            if (gain>32768) gain = 32768;
+            inputs[idx].gain = gain;
+        }
+
+        /// Provides the gain as Q15 value of the indicated input
+        int32_t gainQ15(int idx) {
+            return inputs[idx].gain;
+        }
+
+        /// Defines the number of channels: this drops the incomplete frames of all inputs
+        virtual void setAudioInfo(AudioBaseInfo info) {
+            if (info.bits_per_sample!=16){
+                LOGE("Only 16 bits are supported: %d", info.bits_per_sample);
+            }
+            if (info.channels<=0){
+                LOGE("Invalid channels: %d", info.channels);
+                return;
+            }
+            audio_info = info;
+            partials.resize(inputs.size() * frameSize());
+            for (int j=0;j<inputs.size();j++){
+                inputs[j].partial_len = 0;
+            }
+        }
+
+        /// Provides the number of inputs
+        int size() {
+            return inputs.size();
+        }
+
+        /// Provides the number of bytes which can be mixed: this is defined by the active input with the least data.
+        /// When all inputs have ended we drain the input with the most data.
+        virtual int available() {
+            int result = 0;
+            bool active = false;
+            for (int j=0;j<inputs.size();j++){
+                if (inputs[j].ended) continue;
+                int bytes = inputs[j].in->available() + inputs[j].partial_len;
+                result = active ? min(result, bytes) : bytes;
+                active = true;
+            }
+            if (!active){
+                for (int j=0;j<inputs.size();j++){
+                    result = max(result, inputs[j].in->available() + inputs[j].partial_len);
+                }
+            }
+            return result - result % frameSize();
+        }
+
+        /// Provides the mixed samples: we only return complete frames
+        virtual size_t readBytes(uint8_t *data, size_t length) {
+            if (acc==nullptr) return 0;
+            int channels = audio_info.channels;
+            size_t result = 0;
+            int16_t *out = (int16_t*) data;
+            size_t requested = length / frameSize() * channels;
+            size_t max_samples = buffer_samples / channels * channels;
+            if (max_samples==0){
+                LOGE("bufferSize too small for %d channels", channels);
+                return 0;
+            }
+            while (result < requested){
+                size_t len = mix(out + result, MIN(requested - result, max_samples));
+                result += len;
+                if (len==0) break;
+            }
+            return result * sizeof(int16_t);
+        }
+
+        /// not supported
+        virtual size_t write(const uint8_t *data, size_t len){
+            return 0;
+        }
+
+        /// not supported
+        virtual int availableForWrite() {
+            return 0;
+        }
+
+    protected:
+        struct Input {
+            Stream *in = nullptr;
+            int32_t gain = 32768;
+            int partial_len = 0;
+            bool ended = false;
+        };
+        Vector<Input> inputs;
+        Vector<uint8_t> partials; // incomplete frame of each input
+        Allocator *allocator;
+        int32_t *acc = nullptr;
+        int16_t *samples = nullptr;
+        size_t buffer_samples = 0;
+
+        int frameSize() {
+            return audio_info.channels * sizeof(int16_t);
+        }
+
+        // mixes up to len samples (complete frames) of all active inputs and returns the number of mixed samples
+        size_t mix(int16_t *out, size_t len){
+            int frame_size = frameSize();
+            size_t limit = MIN(len * sizeof(int16_t), (size_t) available());
+            if (limit==0) return 0;
+            bool active = false;
+            for (int j=0;j<inputs.size();j++){
+                active = active || !inputs[j].ended;
+            }
+
+            size_t result = 0;
+            uint8_t *data = (uint8_t*) samples;
+            memset(acc, 0, limit / sizeof(int16_t) * sizeof(int32_t));
+            for (int j=0;j<inputs.size();j++){
+                // continue with the incomplete frame of the last call
+                Input &input = inputs[j];
+                uint8_t *partial = &partials[j * frame_size];
+                memcpy(data, partial, input.partial_len);
+                size_t bytes = input.partial_len;
+                while (bytes < limit){
+                    size_t n = input.in->readBytes(data + bytes, limit - bytes);
+                    if (n==0) break;
+                    bytes += n;
+                }
+                size_t complete = bytes - bytes % frame_size;
+                input.partial_len = bytes - complete;
+                memcpy(partial, data + complete, input.partial_len);
+                if (!input.ended && complete < limit){
+                    LOGW("input %d provided only %d of %d bytes", j, (int) complete, (int) limit);
+                }
+
+                size_t read = complete / sizeof(int16_t);
+                MixerKernel::add(acc, samples, input.gain, read);
+                result = max(result, read);
+            }
+            // while an input is active the others are padded with silence up to the limit
+            if (active) result = limit / sizeof(int16_t);
+            MixerKernel::store(out, acc, result);
+            return result;
+        }
+
+        void releaseBuffers() {
+            allocator->removeArray(acc, buffer_samples);
+            allocator->removeArray(samples, buffer_samples);
+            acc = nullptr;
+            samples = nullptr;
+        }
+};
+
+}
@@ -0,0 +1,625 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/AudioLogger.h"
+#include "AudioTools/Allocator.h"
+#include "AudioTools/Converter.h"
+#include "AudioTools/Vector.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Processing statistics of a single stage of the AudioPipeline
+ */
+struct PipelineStageStats {
+    uint32_t calls = 0;
+    uint32_t bytes_in = 0;
+    uint32_t bytes_out = 0;
+    uint32_t overflows = 0;         // number of calls where the result did not fit into the buffer
+    uint32_t total_us = 0;          // total processing time
+    uint32_t max_us = 0;            // max processing time of a single call
+
+    /// Average processing time of a call in us
+    uint32_t avgUs() {
+        return calls == 0 ? 0 : total_us / calls;
+    }
+
+    /// Records the result of a call
+    void add(size_t in, size_t out, uint32_t us){
+        calls++;
+        bytes_in += in;
+        bytes_out += out;
+        total_us += us;
+        if (us > max_us){
+            max_us = us;
+        }
+    }
+
+    /// Prints the statistics e.g. to Serial
+    void printTo(Print &out) {
+        out.print("calls: "); out.print((unsigned long)calls);
+        out.print(" in: "); out.print((unsigned long)bytes_in);
+        out.print(" out: "); out.print((unsigned long)bytes_out);
+        out.print(" overflows: "); out.print((unsigned long)overflows);
+        out.print(" avg us: "); out.print((unsigned long)avgUs());
+        out.print(" max us: "); out.print((unsigned long)max_us);
+        out.println();
+    }
+};
+
+/**
+ * @brief A processing step of the AudioPipeline: the stage gets the input data and either
+ * updates it in place or writes the result into the provided output buffer.
+ * Subclass it to implement your own effects.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PipelineStage : public AudioBaseInfoDependent {
+    public:
+        virtual ~PipelineStage() = default;
+
+        /// Called before the processing is started
+        virtual void begin() {}
+
+        /// Called when the processing is stopped
+        virtual void end() {}
+
+        /// Defines the audio format of the input: per default the output has the same format
+        virtual void setAudioInfo(AudioBaseInfo info) {
+            output_info = info;
+        }
+
+        /// Provides the audio format of the output
+        virtual AudioBaseInfo audioInfo() {
+            return output_info;
+        }
+
+        /// Returns true if the result is written into the input data (and not into the output buffer)
+        virtual bool isInPlace() {
+            return false;
+        }
+
+        /// Provides the max number of bytes that are returned for the indicated number of input bytes
+        virtual size_t maxOutputSize(size_t inputSize) {
+            return inputSize;
+        }
+
+        /// Processes the data and returns the number of resulting bytes
+        virtual size_t process(uint8_t *data, size_t len, uint8_t *out, size_t outSize) = 0;
+
+        /// Number of input bytes of the last call which could not be processed: the AudioPipeline provides them
+        /// again with the next call (this is only supported for the first stage)
+        virtual size_t unprocessed() {
+            return 0;
+        }
+
+        /// Number of result bytes which the stage keeps for the next calls: the AudioPipeline calls process() 
+        /// as long as there are any, even if there is no more input
+        virtual size_t queued() {
+            return 0;
+        }
+
+        /// Returns true (once) if the audio format of the output has changed
+        bool isAudioInfoChanged() {
+            bool result = is_audio_info_changed;
+            is_audio_info_changed = false;
+            return result;
+        }
+
+        /// Provides the processing statistics
+        PipelineStageStats &stats() {
+            return stage_stats;
+        }
+
+    protected:
+        AudioBaseInfo output_info;
+        PipelineStageStats stage_stats;
+        bool is_audio_info_changed = false;
+};
+
+/**
+ * @brief Pipeline stage which applies a converter to the interleaved data in place: the number of channels
+ * is taken from the audio format (stereo if it is not defined)
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T
+ */
+template<typename T>
+class ConverterStage : public PipelineStage {
+    public:
+        ConverterStage(MultiChannelConverter<T> &converter){
+            this->converter = &converter;
+        }
+
+        virtual bool isInPlace() {
+            return true;
+        }
+
+        virtual size_t process(uint8_t *data, size_t len, uint8_t *out, size_t outSize) {
+            int channels = output_info.channels > 0 ? output_info.channels : 2;
+            size_t frames = len / (sizeof(T)*channels);
+            converter->convertBlock((T*) data, frames, channels);
+            return len;
+        }
+
+    protected:
+        MultiChannelConverter<T> *converter;
+};
+
+/**
+ * @brief Print which writes into a memory area that is provided by the AudioPipeline
+ */
+class PipelineOutput : public Print {
+    public:
+        void begin(uint8_t *data, size_t size){
+            this->data = data;
+            this->size = size;
+            this->len = 0;
+            this->lost = 0;
+        }
+
+        virtual size_t write(uint8_t c) {
+            return write(&c, 1);
+        }
+
+        virtual size_t write(const uint8_t *buffer, size_t bytes) {
+            size_t result = MIN(bytes, size - len);
+            if (result>0) memcpy(data + len, buffer, result);
+            len += result;
+            lost += bytes - result;
+            return result;
+        }
+
+        virtual int availableForWrite() {
+            return size - len;
+        }
+
+        /// Number of bytes that have been written
+        size_t length() {
+            return len;
+        }
+
+        /// Number of bytes that did not fit into the memory
+        size_t lostBytes() {
+            return lost;
+        }
+
+    protected:
+        uint8_t *data = nullptr;
+        size_t size = 0;
+        size_t len = 0;
+        size_t lost = 0;
+};
+
+/**
+ * @brief Pipeline stage which decodes the data: the input is provided to the decoder in slices of sliceSize 
+ * bytes as long as the output has room for maxFrameSize bytes. Some decoders buffer the input and provide the
+ * result of many slices at once (e.g. the MP3DecoderMini): the decoded data which does not fit into the output 
+ * is kept in a queue and provided with the next calls before the decoder gets any new input. The remaining 
+ * input is processed with the next call, so that we do not lose any data even if the decoded data is much 
+ * bigger than the input (e.g. for MP3 with a low bit rate). 
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DecoderStage : public PipelineStage {
+    public:
+        DecoderStage(AudioDecoder &decoder, int maxFrameSize=DECODER_MAX_FRAME_SIZE, int sliceSize=DECODER_SLICE_SIZE){
+            this->decoder = &decoder;
+            this->max_frame_size = maxFrameSize;
+            this->slice_size = sliceSize > 0 ? sliceSize : 1;
+            notify.self = this;
+            output.self = this;
+        }
+
+        virtual void begin() {
+            queue_pos = 0;
+            queue_len = 0;
+            decoder->setOutputStream(output);
+            decoder->setNotifyAudioChange(notify);
+            decoder->begin();
+        }
+
+        /// The data which is provided by the decoder when it ends (e.g. the last frame) is kept in the queue
+        virtual void end() {
+            output.begin(nullptr, 0);
+            decoder->end();
+        }
+
+        /// The input is encoded so we ignore the audio format
+        virtual void setAudioInfo(AudioBaseInfo info) {
+        }
+
+        /// We provide space for at least 2 slices: the rest is processed with the next call
+        virtual size_t maxOutputSize(size_t inputSize) {
+            return inputSize + 2 * max_frame_size;
+        }
+
+        virtual size_t process(uint8_t *data, size_t len, uint8_t *out, size_t outSize) {
+            output.begin(out, outSize);
+            dequeue();
+            size_t pos = 0;
+            while (pos < len && queued()==0){
+                // number of slices which fit into the output
+                size_t slices = output.availableForWrite() / max_frame_size;
+                if (slices==0) break;
+                size_t n = MIN(len - pos, slices * slice_size);
+                decoder->write(data + pos, n);
+                pos += n;
+            }
+            unprocessed_len = len - pos;
+            return output.length();
+        }
+
+        virtual size_t unprocessed() {
+            return unprocessed_len;
+        }
+
+        virtual size_t queued() {
+            return queue_len - queue_pos;
+        }
+
+    protected:
+        // receives the audio format changes from the decoder
+        struct Notify : public AudioBaseInfoDependent {
+            DecoderStage *self;
+            virtual void setAudioInfo(AudioBaseInfo info) {
+                self->output_info = info;
+                self->is_audio_info_changed = true;
+            }
+        } notify;
+        // receives the decoded data: what does not fit into the output is queued
+        struct Output : public PipelineOutput {
+            DecoderStage *self;
+            using PipelineOutput::write;
+            virtual size_t write(const uint8_t *buffer, size_t bytes) {
+                size_t result = PipelineOutput::write(buffer, bytes);
+                if (result<bytes){
+                    self->enqueue(buffer + result, bytes - result);
+                }
+                return bytes;
+            }
+        } output;
+        AudioDecoder *decoder;
+        Vector<uint8_t> queue{0};
+        size_t queue_pos = 0;
+        size_t queue_len = 0;
+        size_t max_frame_size;
+        size_t slice_size;
+        size_t unprocessed_len = 0;
+
+        void enqueue(const uint8_t *data, size_t len) {
+            if (queue_len + len > (size_t) queue.size()){
+                queue.resize(max(queue_len + len, (size_t) queue.size() * 2));
+                LOGI("DecoderStage: queue size %d", queue.size());
+            }
+            memcpy(&queue[queue_len], data, len);
+            queue_len += len;
+        }
+
+        // moves the queued data into the output
+        void dequeue() {
+            size_t n = MIN(queued(), (size_t) output.availableForWrite());
+            output.PipelineOutput::write(&queue[queue_pos], n);
+            queue_pos += n;
+            if (queue_pos==queue_len){
+                queue_pos = 0;
+                queue_len = 0;
+            }
+        }
+};
+
+/**
+ * @brief Pipeline stage which encodes the data
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EncoderStage : public PipelineStage {
+    public:
+        /// headerSize: max number of additional bytes that the encoder might add e.g. for the header
+        EncoderStage(AudioEncoder &encoder, int headerSize=64){
+            this->encoder = &encoder;
+            this->header_size = headerSize;
+        }
+
+        virtual void begin() {
+            encoder->setOutputStream(output);
+            encoder->begin();
+        }
+
+        virtual void end() {
+            encoder->end();
+        }
+
+        virtual void setAudioInfo(AudioBaseInfo info) {
+            PipelineStage::setAudioInfo(info);
+            encoder->setAudioInfo(info);
+        }
+
+        virtual size_t maxOutputSize(size_t inputSize) {
+            return inputSize + header_size;
+        }
+
+        virtual size_t process(uint8_t *data, size_t len, uint8_t *out, size_t outSize) {
+            output.begin(out, outSize);
+            encoder->write(data, len);
+            if (output.lostBytes()>0){
+                LOGE("EncoderStage: %u bytes lost", (unsigned) output.lostBytes());
+                stage_stats.overflows++;
+            }
+            return output.length();
+        }
+
+    protected:
+        AudioEncoder *encoder;
+        PipelineOutput output;
+        int header_size;
+};
+
+/**
+ * @brief Declarative processing chain: the data is read from the source, processed by all stages
+ * (converters, codecs, effects) and written to the sink. All buffers are allocated in begin() so
+ * that process() does not allocate any memory: we use 2 buffers which are sized to the largest stage
+ * and which are alternating as input and output. Changes of the audio format (e.g. reported by a decoder)
+ * are propagated down the chain.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioPipeline {
+    public:
+        AudioPipeline(Stream &source, Print &sink, Allocator &allocator=defaultAllocator()){
+            this->source = &source;
+            this->sink = &sink;
+            this->allocator = &allocator;
+        }
+
+        ~AudioPipeline(){
+            end();
+            for (int j=0;j<owned_stages.size();j++){
+                delete owned_stages[j];
+            }
+        }
+
+        /// Adds a processing stage
+        AudioPipeline &add(PipelineStage &stage){
+            stages.push_back(&stage);
+            return *this;
+        }
+
+        /// Adds a converter
+        template<typename T>
+        AudioPipeline &add(MultiChannelConverter<T> &converter){
+            return addOwned(new ConverterStage<T>(converter));
+        }
+
+        /// Adds a decoder which provides max maxFrameSize bytes for sliceSize input bytes 
+        AudioPipeline &add(AudioDecoder &decoder, int maxFrameSize=DECODER_MAX_FRAME_SIZE, int sliceSize=DECODER_SLICE_SIZE){
+            return addOwned(new DecoderStage(decoder, maxFrameSize, sliceSize));
+        }
+
+        /// Adds an encoder
+        AudioPipeline &add(AudioEncoder &encoder){
+            return addOwned(new EncoderStage(encoder));
+        }
+
+        /// Defines the object which is notified about the audio format which is provided to the sink
+        void setNotifyAudioChange(AudioBaseInfoDependent &bi) {
+            notify_sink = &bi;
+        }
+
+        /// Starts the processing of PCM data with the indicated format: we only read whole frames from the source
+        bool begin(AudioBaseInfo info, int chunkSize=DEFAULT_BUFFER_SIZE){
+            int frame_size = info.channels * info.bits_per_sample / 8;
+            return begin(chunkSize, frame_size, &info);
+        }
+
+        /// Starts the processing of encoded data
+        bool begin(int chunkSize=DEFAULT_BUFFER_SIZE){
+            return begin(chunkSize, 1, nullptr);
+        }
+
+        /// Ends the stages and releases the buffers: the data which the stages provide when they end 
+        /// (e.g. the last frame of a decoder) is written to the sink
+        void end() {
+            if (active){
+                for (int j=0;j<stages.size();j++){
+                    stages[j]->end();
+                    while (stages[j]->queued()>0){
+                        size_t processed = 0;
+                        processStages(j, 0, processed);
+                    }
+                }
+            }
+            releaseBuffers();
+            active = false;
+        }
+
+        /// Reads one chunk from the source and processes it: returns the number of bytes that were read, (when the 
+        /// source has ended) the number of remaining bytes that were processed or the number of bytes that the stages 
+        /// provided from their queue
+        size_t process() {
+            if (!active) return 0;
+            // restore partial frame and unprocessed data from last call
+            memcpy(buffer_a, pending_data, pending);
+            size_t read = source->readBytes(buffer_a + pending, chunk_size - pending);
+            size_t len = pending + read;
+            pending = len % frame_size;
+            len -= pending;
+            memcpy(pending_data, buffer_a + len, pending);
+            size_t processed = len;
+            size_t written = processStages(0, len, processed);
+            if (read > 0) return read;
+            return processed > 0 ? processed : written;
+        }
+
+        /// Provides the number of stages
+        int size() {
+            return stages.size();
+        }
+
+        /// Provides the statistics of the indicated stage
+        PipelineStageStats &stats(int stage) {
+            return stages[stage]->stats();
+        }
+
+        /// Provides the statistics of the output to the sink
+        PipelineStageStats &sinkStats() {
+            return sink_stats;
+        }
+
+        /// Prints the statistics of all stages e.g. to Serial
+        void printStats(Print &out) {
+            for (int j=0;j<stages.size();j++){
+                out.print("stage "); out.print(j); out.print(": ");
+                stages[j]->stats().printTo(out);
+            }
+            out.print("sink: ");
+            sink_stats.printTo(out);
+        }
+
+        /// Provides the audio format which is provided to the sink
+        AudioBaseInfo audioInfo() {
+            return output_info;
+        }
+
+        /// Provides the size of each of the 2 buffers
+        size_t bufferSize() {
+            return buffer_size;
+        }
+
+    protected:
+        Stream *source;
+        Print *sink;
+        Allocator *allocator;
+        AudioBaseInfoDependent *notify_sink = nullptr;
+        Vector<PipelineStage*> stages;
+        Vector<PipelineStage*> owned_stages;
+        PipelineStageStats sink_stats;
+        AudioBaseInfo output_info;
+        uint8_t *buffer_a = nullptr;
+        uint8_t *buffer_b = nullptr;
+        uint8_t *pending_data = nullptr;   // partial frame and unprocessed data of the first stage
+        size_t buffer_size = 0;
+        size_t chunk_size = 0;
+        size_t frame_size = 1;
+        size_t pending = 0;
+        bool active = false;
+
+        /// Processes the len bytes in buffer_a with the stages starting at the indicated one and writes the result 
+        /// to the sink: a stage which has queued data is called even if there is no input. Returns the result size.
+        size_t processStages(int from, size_t len, size_t &processed) {
+            uint8_t *data = buffer_a;
+            uint8_t *other = buffer_b;
+            for (int j=from; j<stages.size(); j++){
+                PipelineStage *stage = stages[j];
+                if (len==0 && stage->queued()==0) continue;
+                uint32_t start = micros();
+                size_t result = stage->process(data, len, other, buffer_size);
+                size_t left = stage->unprocessed();
+                stage->stats().add(len - left, result, micros() - start);
+                if (left>0){
+                    if (j==0){
+                        // keep the unprocessed data (in front of the partial frame) for the next call
+                        memmove(pending_data + left, pending_data, pending);
+                        memcpy(pending_data, data + len - left, left);
+                        pending += left;
+                        processed -= left;
+                    } else {
+                        LOGE("AudioPipeline: stage %d could not process %u bytes", j, (unsigned) left);
+                        stage->stats().overflows++;
+                    }
+                }
+                if (!stage->isInPlace()){
+                    uint8_t *tmp = data;
+                    data = other;
+                    other = tmp;
+                }
+                len = result;
+                if (stage->isAudioInfoChanged()){
+                    setAudioInfo(j+1, stage->audioInfo());
+                }
+            }
+
+            if (len>0){
+                uint32_t start = micros();
+                size_t written = write(data, len);
+                sink_stats.add(len, written, micros() - start);
+                if (written!=len){
+                    LOGE("AudioPipeline: could not write %u bytes", (unsigned) (len - written));
+                    sink_stats.overflows++;
+                }
+            }
+            return len;
+        }
+
+        AudioPipeline &addOwned(PipelineStage *stage){
+            owned_stages.push_back(stage);
+            return add(*stage);
+        }
+
+        bool begin(int chunkSize, int frameSize, AudioBaseInfo *info){
+            end();
+            frame_size = frameSize > 0 ? frameSize : 1;
+            chunk_size = chunkSize / frame_size * frame_size;
+            pending = 0;
+            for (int j=0;j<stages.size();j++){
+                stages[j]->begin();
+            }
+            if (info!=nullptr){
+                setAudioInfo(0, *info);
+            }
+
+            // the buffers must be able to hold the biggest intermediate result
+            size_t size = chunk_size;
+            buffer_size = chunk_size;
+            for (int j=0;j<stages.size();j++){
+                size = stages[j]->maxOutputSize(size);
+                buffer_size = max(buffer_size, size);
+            }
+            LOGI("AudioPipeline buffer size: %u", (unsigned) buffer_size);
+            buffer_a = allocator->createArray<uint8_t>(buffer_size);
+            buffer_b = allocator->createArray<uint8_t>(buffer_size);
+            pending_data = allocator->createArray<uint8_t>(chunk_size);
+            active = buffer_a!=nullptr && buffer_b!=nullptr && pending_data!=nullptr;
+            if (!active){
+                releaseBuffers();
+            }
+            return active;
+        }
+
+        /// Propagates the audio format starting from the indicated stage
+        void setAudioInfo(int from, AudioBaseInfo info){
+            for (int j=from;j<stages.size();j++){
+                stages[j]->setAudioInfo(info);
+                info = stages[j]->audioInfo();
+            }
+            output_info = info;
+            if (notify_sink!=nullptr){
+                notify_sink->setAudioInfo(info);
+            }
+        }
+
+        size_t write(const uint8_t *data, size_t len){
+            size_t total = 0;
+            int retry = 0;
+            while(total<len && retry++ <= 20){
+                total += sink->write(data+total, len-total);
+                if (total<len){
+                    delay(5);
+                }
+            }
+            return total;
+        }
+
+        void releaseBuffers() {
+            allocator->removeArray(buffer_a, buffer_size);
+            allocator->removeArray(buffer_b, buffer_size);
+            allocator->removeArray(pending_data, chunk_size);
+            buffer_a = nullptr;
+            buffer_b = nullptr;
+            pending_data = nullptr;
+        }
+};
+
+}
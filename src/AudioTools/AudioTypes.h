@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Arduino.h"
 #include "AudioConfig.h"
 
 namespace audio_tools {
@@ -58,22 +59,22 @@ class int24_t : public Printable {
     }
 
     operator float() const {
-        return static_cast<float>(*this);
+        return static_cast<int32_t>(*this);
     }
 
-    /// provides value between -32767 and 32767
+    /// provides value between -32768 and 32767
     int16_t scale16() const {
-        return static_cast<float>(*this) * INT16_MAX / INT24_MAX ; 
+        return static_cast<int32_t>(*this) >> 8; 
     }
 
-    /// provides value between -2,147,483,647 and 2,147,483,647
+    /// provides value between -2,147,483,648 and 2,147,483,392
     int32_t scale32() const {
-        return static_cast<float>(*this) / static_cast<float>(INT24_MAX) * static_cast<float>(INT32_MAX) ; 
+        return static_cast<int32_t>(*this) * 256; 
     }
 
     /// provides value between -1.0 and 1.0
     float scaleFloat() const {
-        return static_cast<float>(*this)  / INT24_MAX ; 
+        return static_cast<float>(static_cast<int32_t>(*this)) / INT24_MAX ; 
     }
 
     virtual size_t printTo(Print& p) const {
@@ -118,6 +119,68 @@ class AudioBaseInfoDependent {
       }
 };
 
+/**
+ * @brief Base class for all audio streams: the audio data must be processed with the bulk readBytes() and write()
+ * operations, the single character operations are implemented on top of them. available() and availableForWrite()
+ * must report the number of bytes which can be processed w/o blocking, so that a copy can be sized exactly.
+ * Outputs which can not determine this (e.g. because a driver is blocking) report the recommended transfer size.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioStream : public Stream, public AudioBaseInfoDependent {
+    public:
+        /// Reads up to len bytes: returns the number of bytes that were read
+        virtual size_t readBytes(uint8_t *data, size_t len) = 0;
+        /// Writes up to len bytes: returns the number of bytes that were written
+        virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+        virtual size_t readBytes(char *data, size_t len) {
+            return readBytes((uint8_t*)data, len);
+        }
+
+        using Print::write;
+
+        /// Number of bytes which can be read w/o blocking
+        virtual int available() {
+            return 0;
+        }
+
+        /// Number of bytes which can be written w/o blocking
+        virtual int availableForWrite() {
+            return DEFAULT_BUFFER_SIZE;
+        }
+
+        virtual size_t write(uint8_t c) {
+            return write(&c, 1);
+        }
+
+        virtual int read() {
+            uint8_t c;
+            return readBytes(&c, 1)==1 ? c : -1;
+        }
+
+        /// not supported by most audio streams
+        virtual int peek() {
+            return -1;
+        }
+
+        virtual void flush() {
+        }
+
+        /// Defines the audio format of the data
+        virtual void setAudioInfo(AudioBaseInfo info) {
+            audio_info = info;
+        }
+
+        /// Provides the audio format of the data
+        virtual AudioBaseInfo audioInfo() {
+            return audio_info;
+        }
+
+    protected:
+        AudioBaseInfo audio_info;
+};
+
 
 enum RxTxMode  { TX_MODE, RX_MODE };
 
@@ -2,6 +2,16 @@
 #pragma once
 
 #include "AudioTools/AudioLogger.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/Allocator.h"
+#ifdef USE_ATOMIC
+#include <atomic>
+#endif
+#ifdef USE_MIRRORED_BUFFER
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #undef MIN
 #define MIN(A,B) ((A) < (B) ? (A) : (B))
@@ -11,6 +21,89 @@ namespace audio_tools {
 // forward declaration
 template<typename T> class NBuffer;
 
+/**
+ * @brief Contiguous memory area inside of a buffer which is used by the zero copy api
+ * @tparam T 
+ */
+template<typename T>
+struct BufferSpan {
+    BufferSpan() = default;
+    BufferSpan(T* data, int size){
+        this->data = data;
+        this->size = size;
+    }
+    T* data = nullptr;
+    int size = 0;
+
+    operator bool() {
+        return data!=nullptr && size>0;
+    }
+};
+
+
+/**
+ * @brief Index which is updated by one side (task or ISR) and read by the other side: we use acquire/release
+ * semantics if std::atomic is available (see USE_ATOMIC)
+ * @tparam T 
+ */
+template<typename T>
+struct SharedIndex {
+#ifdef USE_ATOMIC
+    std::atomic<T> value;
+    T load() { return value.load(std::memory_order_acquire); }
+    void store(T v) { value.store(v, std::memory_order_release); }
+#else
+    volatile T value;
+    T load() { return value; }
+    void store(T v) { value = v; }
+#endif
+};
+
+
+/**
+ * @brief Statistics of a buffer which are collected if USE_BUFFER_STATS is set to true. 
+ * All values are in bytes.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct BufferStats {
+    uint32_t level = 0;             // actual fill level
+    uint32_t high_watermark = 0;    // max fill level after a write
+    uint32_t low_watermark = 0;     // min fill level before a read
+    uint32_t underruns = 0;         // number of reads which could not be served completely
+    uint32_t overruns = 0;          // number of writes which could not be stored completely
+    uint32_t bytes_in = 0;
+    uint32_t bytes_out = 0;
+
+    /// Estimated time in ms that the data which is currently in the buffer needs to be played
+    uint32_t latencyMs(AudioBaseInfo info) {
+        return toMs(level, info);
+    }
+
+    /// Estimated max queueing latency in ms 
+    uint32_t maxLatencyMs(AudioBaseInfo info) {
+        return toMs(high_watermark, info);
+    }
+
+    /// Prints the statistics e.g. to Serial
+    void printTo(Print &out) {
+        out.print("level: "); out.print((unsigned long)level);
+        out.print(" high: "); out.print((unsigned long)high_watermark);
+        out.print(" low: "); out.print((unsigned long)low_watermark);
+        out.print(" underruns: "); out.print((unsigned long)underruns);
+        out.print(" overruns: "); out.print((unsigned long)overruns);
+        out.print(" in: "); out.print((unsigned long)bytes_in);
+        out.print(" out: "); out.print((unsigned long)bytes_out);
+        out.println();
+    }
+
+  protected:
+    uint32_t toMs(uint32_t bytes, AudioBaseInfo info) {
+        uint32_t bytes_per_second = info.sample_rate * info.channels * info.bits_per_sample / 8;
+        return bytes_per_second == 0 ? 0 : (uint64_t) bytes * 1000 / bytes_per_second;
+    }
+};
+
 
 /**
  * @brief Shared functionality of all buffers
@@ -20,11 +113,13 @@ template<typename T> class NBuffer;
 template<typename T>
 class BaseBuffer {
 public:
+    virtual ~BaseBuffer() = default;
+
     // reads a single value
     virtual T read() = 0;
     
     // reads multiple values
-    int readArray(T data[], int len){
+    virtual int readArray(T data[], int len){
         int lenResult = MIN(len, available());
         for (int j=0;j<lenResult;j++){
             data[j] = read();
@@ -32,7 +127,8 @@ public:
         return lenResult;
     }
 
-    int writeArray(const T data[], int len){
+    // writes multiple values
+    virtual int writeArray(const T data[], int len){
 	 	LOGD("writeArray: %d", len);
         int result = 0;
         for (int j=0;j<len;j++){
@@ -93,9 +189,93 @@ public:
     // returns the address of the start of the physical read buffer
     virtual T* address() = 0;
 
+    /// Zero copy write: provides up to len contiguous entries which can be filled directly. An empty span is returned if this is not supported.
+    virtual BufferSpan<T> writeReserve(int len) {
+        return BufferSpan<T>();
+    }
+
+    /// Zero copy write: confirms that len entries of the reserved span have been filled
+    virtual void writeCommit(int len) {}
+
+    /// Zero copy read: provides the contiguous entries which can be read directly. An empty span is returned if this is not supported.
+    virtual BufferSpan<T> readPeek() {
+        return BufferSpan<T>();
+    }
+
+    /// Zero copy read: marks len entries of the peeked span as processed
+    virtual void readConsume(int len) {}
+
+    /// Provides the statistics: all values are 0 if USE_BUFFER_STATS is not active
+    BufferStats stats() {
+        BufferStats result;
+#if USE_BUFFER_STATS
+        result = buffer_stats;
+        result.level = fillLevel() * sizeof(T);
+#endif
+        return result;
+    }
+
+    /// Restarts the collection of the statistics
+    void resetStats() {
+#if USE_BUFFER_STATS
+        buffer_stats = BufferStats();
+        stats_low_defined = false;
+#endif
+    }
+
   protected:
+#if USE_BUFFER_STATS
+    BufferStats buffer_stats;
+    bool stats_low_defined = false;
+#endif
+
     void setWritePos(int pos) {};
 
+    /// Number of entries which are used for the statistics
+    virtual int fillLevel() {
+        return available();
+    }
+
+    /// Statistics: len entries have been read
+    inline void statsRead(int len) {
+#if USE_BUFFER_STATS
+        if (len<=0) return;
+        uint32_t bytes = len * sizeof(T);
+        uint32_t level_before = fillLevel() * sizeof(T) + bytes;
+        buffer_stats.bytes_out += bytes;
+        if (!stats_low_defined || level_before < buffer_stats.low_watermark){
+            buffer_stats.low_watermark = level_before;
+            stats_low_defined = true;
+        }
+#endif
+    }
+
+    /// Statistics: len entries have been written
+    inline void statsWrite(int len) {
+#if USE_BUFFER_STATS
+        if (len<=0) return;
+        buffer_stats.bytes_in += len * sizeof(T);
+        uint32_t level = fillLevel() * sizeof(T);
+        if (level > buffer_stats.high_watermark){
+            buffer_stats.high_watermark = level;
+        }
+#endif
+    }
+
+    /// Statistics: checks if a read request could be served completely
+    inline void statsCheckUnderrun(int requested, int result) {
+#if USE_BUFFER_STATS
+        if (result < requested) buffer_stats.underruns++;
+#endif
+    }
+
+    /// Statistics: checks if a write request could be stored completely
+    inline void statsCheckOverrun(int requested, int result) {
+#if USE_BUFFER_STATS
+        if (result < requested) buffer_stats.overruns++;
+#endif
+    }
+
     friend NBuffer<T>;
 
 };
@@ -115,9 +295,13 @@ public:
      * 
      * @param size 
      */
-    SingleBuffer(int size){
+    SingleBuffer(int size, Allocator &allocator=defaultAllocator()){
         this->max_size = size;
-        buffer = new T[max_size];
+        this->allocator = &allocator;
+        buffer = allocator.createArray<T>(max_size);
+        if (buffer==nullptr){
+            max_size = 0;
+        }
         reset();
     }
 
@@ -132,6 +316,19 @@ public:
         reset();
     }
 
+    /**
+     * @brief Construct a new Single Buffer object which uses the provided (not owned) memory
+     * 
+     * @param data 
+     * @param size 
+     */
+    SingleBuffer(T* data, int size){
+        this->max_size = size;
+        this->buffer = data;
+        this->owns_buffer = false;
+        reset();
+    }
+
     /// notifies that the external buffer has been refilled
     void onExternalBufferRefilled(void *data, int len){
         this->owns_buffer = false;
@@ -142,7 +339,7 @@ public:
 
     ~SingleBuffer() {
         if (owns_buffer && buffer!=nullptr){
-            delete[] buffer;
+            allocator->removeArray(buffer, max_size);
         }
     }
 
@@ -152,6 +349,8 @@ public:
             buffer[current_write_pos++] = sample;
             result = true;
         }
+        this->statsCheckOverrun(1, result);
+        this->statsWrite(result);
         return result;
     }
     
@@ -159,6 +358,9 @@ public:
         T result = 0;
         if (buffer != nullptr && current_read_pos < current_write_pos){
             result = buffer[current_read_pos++];
+            this->statsRead(1);
+        } else {
+            this->statsCheckUnderrun(1, 0);
         }
         return result;
     }
@@ -170,6 +372,54 @@ public:
         }
         return result;
     }
+
+    /// reads multiple values with a single memcpy
+    int readArray(T data[], int len){
+        if (buffer == nullptr) return 0;
+        int result = MIN(len, available());
+        if (result>0){
+            memcpy(data, buffer+current_read_pos, result*sizeof(T));
+            current_read_pos += result;
+        }
+        this->statsCheckUnderrun(len, result);
+        this->statsRead(result);
+        return result;
+    }
+
+    /// writes multiple values with a single memcpy
+    int writeArray(const T data[], int len){
+        if (buffer == nullptr) return 0;
+        int result = MIN(len, availableToWrite());
+        if (result>0){
+            memcpy(buffer+current_write_pos, data, result*sizeof(T));
+            current_write_pos += result;
+        }
+        this->statsCheckOverrun(len, result);
+        this->statsWrite(result);
+        return result;
+    }
+
+    BufferSpan<T> writeReserve(int len){
+        if (buffer == nullptr) return BufferSpan<T>();
+        return BufferSpan<T>(buffer+current_write_pos, MIN(len, availableToWrite()));
+    }
+
+    void writeCommit(int len){
+        len = MIN(len, availableToWrite());
+        current_write_pos += len;
+        this->statsWrite(len);
+    }
+
+    BufferSpan<T> readPeek(){
+        if (buffer == nullptr) return BufferSpan<T>();
+        return BufferSpan<T>(buffer+current_read_pos, available());
+    }
+
+    void readConsume(int len){
+        len = MIN(len, available());
+        current_read_pos += len;
+        this->statsRead(len);
+    }
     
     int available() {
         int result = current_write_pos - current_read_pos;
@@ -209,6 +459,7 @@ protected:
     int current_write_pos=0;
     bool owns_buffer = true;
     T *buffer = nullptr;
+    Allocator *allocator = nullptr;
 
     void setWritePos(int pos) {
         current_write_pos = pos;
@@ -225,23 +476,30 @@ protected:
 template<typename T>
 class RingBuffer : public BaseBuffer<T> {
     public:
-        RingBuffer(int size){
+        RingBuffer(int size, Allocator &allocator=defaultAllocator()){
             this->max_size = size;
-            _aucBuffer = new T[max_size];
+            this->allocator = &allocator;
+            _aucBuffer = allocator.createArray<T>(max_size);
+            if (_aucBuffer==nullptr){
+                max_size = 0;
+            }
             reset();
         }
         
         ~RingBuffer() {
-            delete[] _aucBuffer;
+            allocator->removeArray(_aucBuffer, max_size);
         }
 
         virtual T read(){
-            if (isEmpty())
+            if (isEmpty()){
+                this->statsCheckUnderrun(1, 0);
                 return -1;
+            }
 
-            uint8_t value = _aucBuffer[_iTail];
+            T value = _aucBuffer[_iTail];
             _iTail = nextIndex(_iTail);
             _numElems--;
+            this->statsRead(1);
 
             return value;
         }
@@ -272,8 +530,68 @@ class RingBuffer : public BaseBuffer<T> {
                 _numElems++;
                 result = true;
             }
+            this->statsCheckOverrun(1, result);
+            this->statsWrite(result);
+            return result;
+        }
+
+        /// reads multiple values: we copy at most 2 contiguous segments with memcpy
+        virtual int readArray(T data[], int len){
+            int result = MIN(len, available());
+            this->statsCheckUnderrun(len, result);
+            if (result<=0) return 0;
+            int first = MIN(result, max_size - _iTail);
+            memcpy(data, _aucBuffer + _iTail, first*sizeof(T));
+            if (result>first){
+                memcpy(data+first, _aucBuffer, (result-first)*sizeof(T));
+            }
+            _iTail = addIndex(_iTail, result);
+            _numElems -= result;
+            this->statsRead(result);
             return result;
         }
+
+        /// writes multiple values: we copy at most 2 contiguous segments with memcpy
+        virtual int writeArray(const T data[], int len){
+            int result = MIN(len, availableToWrite());
+            this->statsCheckOverrun(len, result);
+            if (result<=0) return 0;
+            int first = MIN(result, max_size - _iHead);
+            memcpy(_aucBuffer + _iHead, data, first*sizeof(T));
+            if (result>first){
+                memcpy(_aucBuffer, data+first, (result-first)*sizeof(T));
+            }
+            _iHead = addIndex(_iHead, result);
+            _numElems += result;
+            this->statsWrite(result);
+            return result;
+        }
+
+        /// provides the free contiguous area up to the end of the physical buffer
+        virtual BufferSpan<T> writeReserve(int len){
+            int result = MIN(MIN(len, availableToWrite()), max_size - _iHead);
+            return BufferSpan<T>(_aucBuffer + _iHead, result);
+        }
+
+        virtual void writeCommit(int len){
+            len = MIN(len, availableToWrite());
+            _iHead = addIndex(_iHead, len);
+            _numElems += len;
+            this->statsWrite(len);
+        }
+
+        /// provides the filled contiguous area up to the end of the physical buffer
+        virtual BufferSpan<T> readPeek(){
+            int result = MIN(available(), max_size - _iTail);
+            return BufferSpan<T>(_aucBuffer + _iTail, result);
+        }
+
+        virtual void readConsume(int len){
+            len = MIN(len, available());
+            _iTail = addIndex(_iTail, len);
+            _numElems -= len;
+            this->statsRead(len);
+        }
         
         // clears the buffer
         virtual void reset() {
@@ -304,16 +622,396 @@ class RingBuffer : public BaseBuffer<T> {
         volatile int _iTail ;
         volatile int _numElems;
         int max_size;
+        Allocator *allocator;
 
         int nextIndex(int index){
             return (uint32_t)(index + 1) % max_size;
         }
 
+        // advances the index by n (n<=max_size) w/o modulo
+        int addIndex(int index, int n){
+            int result = index + n;
+            return result >= max_size ? result - max_size : result;
+        }
+
     
 };
 
+#ifdef USE_ATOMIC
+
+/**
+ * @brief Lock free single producer / single consumer RingBuffer: One task (or ISR) is writing and 
+ * another one is reading. We do not use any shared counter: the producer only updates the head and 
+ * the consumer only updates the tail index with acquire/release semantics. 
+ * The indexes are kept in the range of 0 to 2*size, so that we can distinguish a full from an empty buffer.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T 
+ */
+template<typename T>
+class AtomicRingBuffer : public BaseBuffer<T> {
+    public:
+        AtomicRingBuffer(int size, Allocator &allocator=defaultAllocator()){
+            this->max_size = size;
+            this->allocator = &allocator;
+            _aucBuffer = allocator.createArray<T>(max_size);
+            if (_aucBuffer==nullptr){
+                max_size = 0;
+            }
+            _iHead.store(0);
+            _iTail.store(0);
+        }
+        
+        ~AtomicRingBuffer() {
+            allocator->removeArray(_aucBuffer, max_size);
+        }
+
+        /// reads a single value - consumer only
+        virtual T read(){
+            T result = -1;
+            readArray(&result, 1);
+            return result;
+        }
+
+        /// peeks the actual entry from the buffer - consumer only
+        virtual T peek() {
+            int tail = _iTail.load(std::memory_order_relaxed);
+            if (distance(_iHead.load(std::memory_order_acquire), tail)==0)
+                return -1;
+            return _aucBuffer[position(tail)];
+        }
+
+        /// checks if the buffer is full - producer only
+        virtual bool isFull() {
+            return availableToWrite()==0;
+        }
+
+        /// write add an entry to the buffer - producer only
+        virtual bool write(T data) {
+            return writeArray(&data, 1)==1;
+        }
+
+        /// reads multiple values: we copy at most 2 contiguous segments - consumer only
+        virtual int readArray(T data[], int len){
+            int tail = _iTail.load(std::memory_order_relaxed);
+            int head = _iHead.load(std::memory_order_acquire);
+            int result = MIN(len, distance(head, tail));
+            this->statsCheckUnderrun(len, result);
+            if (result<=0) return 0;
+            int pos = position(tail);
+            int first = MIN(result, max_size - pos);
+            memcpy(data, _aucBuffer + pos, first*sizeof(T));
+            if (result>first){
+                memcpy(data+first, _aucBuffer, (result-first)*sizeof(T));
+            }
+            // publish the free space to the producer
+            _iTail.store(addIndex(tail, result), std::memory_order_release);
+            this->statsRead(result);
+            return result;
+        }
+
+        /// writes multiple values: we copy at most 2 contiguous segments - producer only
+        virtual int writeArray(const T data[], int len){
+            int head = _iHead.load(std::memory_order_relaxed);
+            int tail = _iTail.load(std::memory_order_acquire);
+            int result = MIN(len, max_size - distance(head, tail));
+            this->statsCheckOverrun(len, result);
+            if (result<=0) return 0;
+            int pos = position(head);
+            int first = MIN(result, max_size - pos);
+            memcpy(_aucBuffer + pos, data, first*sizeof(T));
+            if (result>first){
+                memcpy(_aucBuffer, data+first, (result-first)*sizeof(T));
+            }
+            // publish the data to the consumer
+            _iHead.store(addIndex(head, result), std::memory_order_release);
+            this->statsWrite(result);
+            return result;
+        }
+
+        /// provides the free contiguous area up to the end of the physical buffer - producer only
+        virtual BufferSpan<T> writeReserve(int len){
+            int head = _iHead.load(std::memory_order_relaxed);
+            int tail = _iTail.load(std::memory_order_acquire);
+            int pos = position(head);
+            int result = MIN(MIN(len, max_size - distance(head, tail)), max_size - pos);
+            return BufferSpan<T>(_aucBuffer + pos, result);
+        }
+
+        /// publishes the filled entries to the consumer - producer only
+        virtual void writeCommit(int len){
+            int head = _iHead.load(std::memory_order_relaxed);
+            int tail = _iTail.load(std::memory_order_acquire);
+            len = MIN(len, max_size - distance(head, tail));
+            _iHead.store(addIndex(head, len), std::memory_order_release);
+            this->statsWrite(len);
+        }
+
+        /// provides the filled contiguous area up to the end of the physical buffer - consumer only
+        virtual BufferSpan<T> readPeek(){
+            int tail = _iTail.load(std::memory_order_relaxed);
+            int head = _iHead.load(std::memory_order_acquire);
+            int pos = position(tail);
+            int result = MIN(distance(head, tail), max_size - pos);
+            return BufferSpan<T>(_aucBuffer + pos, result);
+        }
+
+        /// releases the processed entries to the producer - consumer only
+        virtual void readConsume(int len){
+            int tail = _iTail.load(std::memory_order_relaxed);
+            int head = _iHead.load(std::memory_order_acquire);
+            len = MIN(len, distance(head, tail));
+            _iTail.store(addIndex(tail, len), std::memory_order_release);
+            this->statsRead(len);
+        }
+        
+        /// clears the buffer by dropping all unread entries - consumer only
+        virtual void reset() {
+            _iTail.store(_iHead.load(std::memory_order_acquire), std::memory_order_release);
+        }
+        
+        /// provides the number of entries that are available to read
+        virtual int available() {
+            return distance(_iHead.load(std::memory_order_acquire), _iTail.load(std::memory_order_acquire));
+        }
+        
+        /// provides the number of entries that are available to write
+        virtual int availableToWrite() {
+            return max_size - available();
+        }
+        
+        /// returns the address of the start of the physical buffer
+        virtual T* address() {
+            return _aucBuffer;
+        }
+
+    protected:
+        T *_aucBuffer = nullptr;
+        std::atomic<int> _iHead;
+        std::atomic<int> _iTail;
+        int max_size = 0;
+        Allocator *allocator;
+
+        /// Constructor for subclasses which provide the memory
+        AtomicRingBuffer() {
+            this->allocator = &defaultAllocator();
+            _iHead.store(0);
+            _iTail.store(0);
+        }
+
+        // number of entries between the two indexes
+        int distance(int head, int tail){
+            int result = head - tail;
+            return result < 0 ? result + 2 * max_size : result;
+        }
+
+        // maps the index to the physical position
+        int position(int index){
+            return index >= max_size ? index - max_size : index;
+        }
+
+        // advances the index by n (n<=max_size) w/o modulo
+        int addIndex(int index, int n){
+            int result = index + n;
+            return result >= 2 * max_size ? result - 2 * max_size : result;
+        }
+};
+
+#endif
+
+#if defined(USE_MIRRORED_BUFFER) && defined(USE_ATOMIC)
+
+/**
+ * @brief Lock free single producer / single consumer RingBuffer where the memory is mapped twice
+ * one after the other into the virtual address space (with memfd_create and mmap): so the data 
+ * at the end of the buffer continues at the beginning and any read or write (up to the capacity) 
+ * is one contiguous memory area. This makes the zero copy api trivial because there is no wrap around.
+ * The size is rounded up to a multiple of the page size. This is only available on Linux.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T 
+ */
+template<typename T>
+class MirroredRingBuffer : public AtomicRingBuffer<T> {
+    public:
+        MirroredRingBuffer(int size) {
+            long page_size = sysconf(_SC_PAGESIZE);
+            size_t bytes = ((size * sizeof(T) + page_size - 1) / page_size) * page_size;
+            // the mirror must end at an entry boundary
+            while (bytes % sizeof(T) != 0){
+                bytes += page_size;
+            }
+            if (map(bytes)){
+                this->max_size = bytes / sizeof(T);
+            } else {
+                LOGE("MirroredRingBuffer: could not map %u bytes", (unsigned)bytes);
+            }
+        }
+
+        ~MirroredRingBuffer() {
+            if (this->_aucBuffer!=nullptr){
+                munmap(this->_aucBuffer, 2 * mapped_bytes);
+                this->_aucBuffer = nullptr;
+            }
+        }
+
+        /// reads multiple values with a single memcpy - consumer only
+        virtual int readArray(T data[], int len){
+            int tail = this->_iTail.load(std::memory_order_relaxed);
+            int head = this->_iHead.load(std::memory_order_acquire);
+            int result = MIN(len, this->distance(head, tail));
+            this->statsCheckUnderrun(len, result);
+            if (result<=0) return 0;
+            memcpy(data, this->_aucBuffer + this->position(tail), result*sizeof(T));
+            this->_iTail.store(this->addIndex(tail, result), std::memory_order_release);
+            this->statsRead(result);
+            return result;
+        }
+
+        /// writes multiple values with a single memcpy - producer only
+        virtual int writeArray(const T data[], int len){
+            int head = this->_iHead.load(std::memory_order_relaxed);
+            int tail = this->_iTail.load(std::memory_order_acquire);
+            int result = MIN(len, this->max_size - this->distance(head, tail));
+            this->statsCheckOverrun(len, result);
+            if (result<=0) return 0;
+            memcpy(this->_aucBuffer + this->position(head), data, result*sizeof(T));
+            this->_iHead.store(this->addIndex(head, result), std::memory_order_release);
+            this->statsWrite(result);
+            return result;
+        }
+
+        /// provides all free entries as one contiguous area - producer only
+        virtual BufferSpan<T> writeReserve(int len){
+            if (this->_aucBuffer==nullptr) return BufferSpan<T>();
+            int head = this->_iHead.load(std::memory_order_relaxed);
+            int tail = this->_iTail.load(std::memory_order_acquire);
+            int result = MIN(len, this->max_size - this->distance(head, tail));
+            return BufferSpan<T>(this->_aucBuffer + this->position(head), result);
+        }
+
+        /// provides all unread entries as one contiguous area - consumer only
+        virtual BufferSpan<T> readPeek(){
+            if (this->_aucBuffer==nullptr) return BufferSpan<T>();
+            int tail = this->_iTail.load(std::memory_order_relaxed);
+            int head = this->_iHead.load(std::memory_order_acquire);
+            return BufferSpan<T>(this->_aucBuffer + this->position(tail), this->distance(head, tail));
+        }
+
+        /// provides the capacity
+        int size() {
+            return this->max_size;
+        }
+
+    protected:
+        size_t mapped_bytes = 0;
+
+        /// maps the same shared memory twice into a reserved address range
+        bool map(size_t bytes) {
+            int fd = syscall(SYS_memfd_create, "audio-tools", 0);
+            if (fd<0) return false;
+            if (ftruncate(fd, bytes)!=0){
+                close(fd);
+                return false;
+            }
+            uint8_t *area = (uint8_t*) mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            bool ok = area != MAP_FAILED;
+            ok = ok && mmap(area, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+            ok = ok && mmap(area + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+            // the mappings keep the memory alive
+            close(fd);
+            if (!ok){
+                if (area != MAP_FAILED) munmap(area, 2 * bytes);
+                return false;
+            }
+            this->_aucBuffer = (T*) area;
+            mapped_bytes = bytes;
+            return true;
+        }
+};
+
+#endif
+
+/**
+ * @brief Fixed size circular queue of buffer pointers with one producer and one consumer. Push and pop are O(1) 
+ * and the head and tail indexes are published with acquire/release semantics (if USE_ATOMIC is available), 
+ * so that the producer and the consumer can run on different cores or in an ISR.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T 
+ */
+template<typename T>
+class BufferPointerQueue {
+    public:
+        BufferPointerQueue(int count){
+            // we need one additional slot to distinguish full from empty
+            capacity = count + 1;
+            entries = new T*[capacity];
+            owns_entries = true;
+            head.store(0);
+            tail.store(0);
+        }
+
+        /// Uses the provided memory which must be able to hold count + 1 entries
+        BufferPointerQueue(T** storage, int count){
+            capacity = count + 1;
+            entries = storage;
+            owns_entries = false;
+            head.store(0);
+            tail.store(0);
+        }
+
+        ~BufferPointerQueue(){
+            if (owns_entries){
+                delete[] entries;
+            }
+        }
+
+        /// adds an entry at the end - producer only
+        bool push(T* ptr){
+            int current = head.load();
+            int next = nextIndex(current);
+            if (next == tail.load()){
+                return false;
+            }
+            entries[current] = ptr;
+            head.store(next);
+            return true;
+        }
+
+        /// removes the oldest entry - consumer only: returns nullptr if the queue is empty
+        T* pop(){
+            int current = tail.load();
+            if (current == head.load()){
+                return nullptr;
+            }
+            T* result = entries[current];
+            tail.store(nextIndex(current));
+            return result;
+        }
+
+        /// number of entries in the queue
+        int size(){
+            int result = head.load() - tail.load();
+            return result < 0 ? result + capacity : result;
+        }
+
+    protected:
+        T** entries = nullptr;
+        bool owns_entries = false;
+        int capacity = 0;
+        SharedIndex<int> head;
+        SharedIndex<int> tail;
+
+        int nextIndex(int index){
+            return index + 1 == capacity ? 0 : index + 1;
+        }
+};
+
 /**
  * @brief A lock free N buffer. If count=2 we create a DoubleBuffer, if count=3 a TripleBuffer etc.
+ * The writer and the reader can run in different tasks (or in an ISR): the buffers are exchanged via 
+ * two single producer/single consumer queues.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -321,19 +1019,18 @@ template<typename T>
 class NBuffer : public BaseBuffer<T> {
 public:
 
-  NBuffer(int size=512, int count=2){
-      filled_buffers = new BaseBuffer<T>*[count];
-      avaliable_buffers = new BaseBuffer<T>*[count];
-
-      write_buffer_count = 0;
+  NBuffer(int size=512, int count=2, Allocator &allocator=defaultAllocator()) : avaliable_buffers(count), filled_buffers(count) {
       buffer_count = count;
       buffer_size = size;
       for (int j=0;j<count;j++){
-        avaliable_buffers[j] = new SingleBuffer<T>(size);
+        avaliable_buffers.push(new SingleBuffer<T>(size, allocator));
       }
   }
 
   ~NBuffer() {
+      // the buffers are managed by the subclass
+      if (!owns_buffers) return;
+
       delete actual_write_buffer;
       delete actual_read_buffer;
 
@@ -356,6 +1053,9 @@ public:
       T result = 0;
       if (available()>0){
           result = actual_read_buffer->read();
+          this->statsRead(1);
+      } else {
+          this->statsCheckUnderrun(1, 0);
       }
       return result;
   }
@@ -395,10 +1095,84 @@ public:
           start_time = millis();
       }
       sample_count++;
+      this->statsCheckOverrun(1, result);
+      this->statsWrite(result);
       
       return result;
   }
 
+  // writes multiple values: we copy the data directly into the write buffers
+  int writeArray(const T data[], int len){
+      int result = 0;
+      while (result<len){
+          BufferSpan<T> span = writeReserve(len-result);
+          if (!span) break;
+          memcpy(span.data, data+result, span.size*sizeof(T));
+          writeCommit(span.size);
+          result += span.size;
+      }
+      this->statsCheckOverrun(len, result);
+      return result;
+  }
+
+  // reads multiple values: we copy the data directly from the read buffers
+  int readArray(T data[], int len){
+      int result = 0;
+      while (result<len){
+          BufferSpan<T> span = readPeek();
+          if (!span) break;
+          int n = MIN(span.size, len-result);
+          memcpy(data+result, span.data, n*sizeof(T));
+          readConsume(n);
+          result += n;
+      }
+      this->statsCheckUnderrun(len, result);
+      return result;
+  }
+
+  /// provides the free area of the actual write buffer
+  BufferSpan<T> writeReserve(int len){
+      if (availableToWrite()==0){
+          return BufferSpan<T>();
+      }
+      return actual_write_buffer->writeReserve(len);
+  }
+
+  /// confirms the filled entries: a full buffer is moved to the filled buffers
+  void writeCommit(int len){
+      if (actual_write_buffer!=nullptr){
+          actual_write_buffer->writeCommit(len);
+          if (start_time==0l){
+              start_time = millis();
+          }
+          sample_count += len;
+          this->statsWrite(len);
+          if (actual_write_buffer->isFull()){
+              addFilledBuffer(actual_write_buffer);
+              actual_write_buffer = getNextAvailableBuffer();
+          }
+      }
+  }
+
+  /// provides the unread area of the actual read buffer
+  BufferSpan<T> readPeek(){
+      if (available()==0){
+          return BufferSpan<T>();
+      }
+      return actual_read_buffer->readPeek();
+  }
+
+  /// marks the entries as processed: an empty buffer is made available again
+  void readConsume(int len){
+      if (actual_read_buffer!=nullptr){
+          actual_read_buffer->readConsume(len);
+          this->statsRead(len);
+          if (actual_read_buffer->available()==0){
+              resetCurrent();
+          }
+      }
+  }
+
   // deterMINes the available entries for the current read buffer
   int available() {
       if (actual_read_buffer==nullptr){
@@ -458,7 +1232,8 @@ public:
   // Alternative interface using address: the current buffer has been filled
   BaseBuffer<T> &writeEnd(){
     if (actual_write_buffer!=nullptr){
-        actual_write_buffer->setWritePos(buffer_size);
+        // the data was written directly into the address: mark the buffer as full
+        actual_write_buffer->writeCommit(actual_write_buffer->availableToWrite());
         addFilledBuffer(actual_write_buffer);
     }
     actual_write_buffer = getNextAvailableBuffer();
@@ -476,14 +1251,35 @@ public:
 protected:
     int buffer_size = 0;
     uint16_t buffer_count = 0;
-    uint16_t write_buffer_count = 0;
+    bool owns_buffers = true;
+    // only used by the reader
     BaseBuffer<T> *actual_read_buffer = nullptr;
+    // only used by the writer
     BaseBuffer<T> *actual_write_buffer = nullptr;
-    BaseBuffer<T> **avaliable_buffers = nullptr;
-    BaseBuffer<T> **filled_buffers = nullptr;
+    // the reader is adding the processed buffers, the writer is taking them
+    BufferPointerQueue<BaseBuffer<T>> avaliable_buffers;
+    // the writer is adding the full buffers, the reader is taking them
+    BufferPointerQueue<BaseBuffer<T>> filled_buffers;
     unsigned long start_time = 0;
     unsigned long sample_count = 0;
 
+    /// Constructor for subclasses which provide the buffers: the queue_storage must hold 2 * (count + 1) entries
+    NBuffer(int size, int count, BaseBuffer<T>** queue_storage) : avaliable_buffers(queue_storage, count), filled_buffers(queue_storage + count + 1, count) {
+      buffer_count = count;
+      buffer_size = size;
+      owns_buffers = false;
+    }
+
+    /// Statistics: all filled buffers are counted
+    int fillLevel() {
+        int result = filled_buffers.size() * buffer_size;
+        BaseBuffer<T> *read_buffer = actual_read_buffer;
+        if (read_buffer!=nullptr){
+            result += read_buffer->available();
+        }
+        return result;
+    }
+
     void resetCurrent(){
       if (actual_read_buffer!=nullptr){
           actual_read_buffer->reset();
@@ -494,53 +1290,283 @@ protected:
     }
 
     BaseBuffer<T> *getNextAvailableBuffer() {
-        BaseBuffer<T> *result = nullptr;
-        for (int j=0;j<buffer_count;j++){
-            result = avaliable_buffers[j];
-            if (result!=nullptr){
-                avaliable_buffers[j] = nullptr;
-                break;
-            }
-        }
-        return result;
+        return avaliable_buffers.pop();
     }
     
     bool addAvailableBuffer(BaseBuffer<T> *buffer){
-        bool result = false;
-        for (int j=0;j<buffer_count;j++){
-            if (avaliable_buffers[j]==nullptr){
-                avaliable_buffers[j] = buffer;
-                result = true;
-                break;
-            }
-        }
-        return result;
+        return avaliable_buffers.push(buffer);
     }
     
     BaseBuffer<T> *getNextFilledBuffer() {
-        BaseBuffer<T> *result = nullptr;
-        if (write_buffer_count > 0){
-            // get oldest entry
-            result = filled_buffers[0];
-            // move data by 1 entry to the left
-            for (int j=0;j<write_buffer_count-1;j++)
-                filled_buffers[j]=filled_buffers[j+1];
-            // clear last enty
-            filled_buffers[write_buffer_count-1]=nullptr;
-            write_buffer_count--;
-        }
-        return result;
+        // get oldest entry
+        return filled_buffers.pop();
     }
     
     bool addFilledBuffer(BaseBuffer<T> *buffer){
-        bool result = false;
-        if (write_buffer_count<buffer_count){
-            filled_buffers[write_buffer_count++] = buffer;
-            result = true;
-        }
-        return result;
+        return filled_buffers.push(buffer);
     }
 
 };
 
+/**
+ * @brief Determines the smallest power of 2 which is >= n: e.g. to calculate the size of a RingBufferT
+ */
+constexpr int nextPowerOf2(int n, int result=1){
+    return result >= n ? result : nextPowerOf2(n, result * 2);
+}
+
+/**
+ * @brief Ring buffer with a size that is defined at compile time: the data is stored in the object itself, so 
+ * that no heap is needed. N must be a power of 2, so that we can use a mask instead of a modulo. 
+ * The head and tail are free running counters which are updated with acquire/release semantics (if 
+ * USE_ATOMIC is available): so this can also be used with a single producer and a single consumer in different 
+ * tasks or in an ISR.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T 
+ * @tparam N 
+ */
+template<typename T, int N>
+class RingBufferT : public BaseBuffer<T> {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+    public:
+        RingBufferT() {
+            _iHead.store(0);
+            _iTail.store(0);
+        }
+
+        virtual T read(){
+            uint32_t tail = _iTail.load();
+            if (_iHead.load() == tail){
+                this->statsCheckUnderrun(1, 0);
+                return -1;
+            }
+            T result = _aucBuffer[tail & mask];
+            _iTail.store(tail + 1);
+            this->statsRead(1);
+            return result;
+        }
+
+        virtual T peek() {
+            uint32_t tail = _iTail.load();
+            if (_iHead.load() == tail)
+                return -1;
+            return _aucBuffer[tail & mask];
+        }
+
+        virtual bool isFull() {
+            return availableToWrite()==0;
+        }
+
+        virtual bool write(T data) {
+            uint32_t head = _iHead.load();
+            if (head - _iTail.load() >= (uint32_t)N){
+                this->statsCheckOverrun(1, 0);
+                return false;
+            }
+            _aucBuffer[head & mask] = data;
+            _iHead.store(head + 1);
+            this->statsWrite(1);
+            return true;
+        }
+
+        /// reads multiple values: we copy at most 2 contiguous segments
+        virtual int readArray(T data[], int len){
+            uint32_t tail = _iTail.load();
+            int result = MIN(len, (int)(_iHead.load() - tail));
+            this->statsCheckUnderrun(len, result);
+            if (result<=0) return 0;
+            int pos = tail & mask;
+            int first = MIN(result, N - pos);
+            memcpy(data, _aucBuffer + pos, first*sizeof(T));
+            if (result>first){
+                memcpy(data+first, _aucBuffer, (result-first)*sizeof(T));
+            }
+            _iTail.store(tail + result);
+            this->statsRead(result);
+            return result;
+        }
+
+        /// writes multiple values: we copy at most 2 contiguous segments
+        virtual int writeArray(const T data[], int len){
+            uint32_t head = _iHead.load();
+            int result = MIN(len, N - (int)(head - _iTail.load()));
+            this->statsCheckOverrun(len, result);
+            if (result<=0) return 0;
+            int pos = head & mask;
+            int first = MIN(result, N - pos);
+            memcpy(_aucBuffer + pos, data, first*sizeof(T));
+            if (result>first){
+                memcpy(_aucBuffer, data+first, (result-first)*sizeof(T));
+            }
+            _iHead.store(head + result);
+            this->statsWrite(result);
+            return result;
+        }
+
+        virtual BufferSpan<T> writeReserve(int len){
+            uint32_t head = _iHead.load();
+            int pos = head & mask;
+            int result = MIN(MIN(len, N - (int)(head - _iTail.load())), N - pos);
+            return BufferSpan<T>(_aucBuffer + pos, result);
+        }
+
+        virtual void writeCommit(int len){
+            uint32_t head = _iHead.load();
+            len = MIN(len, N - (int)(head - _iTail.load()));
+            _iHead.store(head + len);
+            this->statsWrite(len);
+        }
+
+        virtual BufferSpan<T> readPeek(){
+            uint32_t tail = _iTail.load();
+            int pos = tail & mask;
+            int result = MIN((int)(_iHead.load() - tail), N - pos);
+            return BufferSpan<T>(_aucBuffer + pos, result);
+        }
+
+        virtual void readConsume(int len){
+            uint32_t tail = _iTail.load();
+            len = MIN(len, (int)(_iHead.load() - tail));
+            _iTail.store(tail + len);
+            this->statsRead(len);
+        }
+
+        /// clears the buffer by dropping all unread entries 
+        virtual void reset() {
+            _iTail.store(_iHead.load());
+        }
+
+        virtual int available() {
+            return _iHead.load() - _iTail.load();
+        }
+
+        virtual int availableToWrite() {
+            return N - available();
+        }
+
+        virtual T* address() {
+            return _aucBuffer;
+        }
+
+        /// provides the capacity
+        constexpr int size() {
+            return N;
+        }
+
+    protected:
+        static const uint32_t mask = N - 1;
+
+        T _aucBuffer[N];
+        // free running counters
+        SharedIndex<uint32_t> _iHead;
+        SharedIndex<uint32_t> _iTail;
+};
+
+/**
+ * @brief NBuffer with a size and count that is defined at compile time: all buffers are stored in the object
+ * itself, so that no heap is needed.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T 
+ * @tparam Size number of entries per buffer
+ * @tparam Count number of buffers
+ */
+template<typename T, int Size, int Count>
+class NBufferT : public NBuffer<T> {
+    public:
+        NBufferT() : NBuffer<T>(Size, Count, queue_storage) {
+            for (int j=0;j<Count;j++){
+                buffers[j] = SingleBuffer<T>(data[j], Size);
+                this->addAvailableBuffer(&buffers[j]);
+            }
+        }
+
+    protected:
+        T data[Count][Size];
+        SingleBuffer<T> buffers[Count];
+        BaseBuffer<T>* queue_storage[2 * (Count + 1)];
+};
+
+/**
+ * @brief Frame aware access to a byte buffer: the data is read and written in whole frames only 
+ * (channels * bits_per_sample / 8 bytes), so that a consumer never gets a torn frame and does not need 
+ * to check the bounds per sample. If you use a NBuffer the buffer size must be a multiple of the frame size.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FrameBuffer {
+    public:
+        FrameBuffer() = default;
+
+        FrameBuffer(BaseBuffer<uint8_t> &buffer, AudioBaseInfo info){
+            begin(buffer, info);
+        }
+
+        /// Defines the byte buffer and the audio format
+        void begin(BaseBuffer<uint8_t> &buffer, AudioBaseInfo info){
+            this->buffer = &buffer;
+            setAudioInfo(info);
+        }
+
+        /// Updates the audio format which defines the frame size
+        void setAudioInfo(AudioBaseInfo info){
+            frame_size = info.channels * info.bits_per_sample / 8;
+            if (frame_size<=0){
+                LOGE("Invalid frame size: channels %d, bits_per_sample %d", info.channels, info.bits_per_sample);
+                frame_size = 1;
+            }
+        }
+
+        /// Provides the number of bytes of a frame
+        int frameSize() {
+            return frame_size;
+        }
+
+        /// Provides the number of frames that can be read
+        int available() {
+            return buffer==nullptr ? 0 : buffer->available() / frame_size;
+        }
+
+        /// Provides the number of frames that can be written
+        int availableToWrite() {
+            return buffer==nullptr ? 0 : buffer->availableToWrite() / frame_size;
+        }
+
+        /// Reads up to frames frames: data must be able to hold frames * channels samples. Returns the number of frames
+        template <typename T>
+        int readFrames(T* data, int frames){
+            int result = MIN(frames, available());
+            if (result>0){
+                buffer->readArray((uint8_t*)data, result * frame_size);
+            }
+            return result;
+        }
+
+        /// Writes up to frames frames. Returns the number of frames
+        template <typename T>
+        int writeFrames(const T* data, int frames){
+            int result = MIN(frames, availableToWrite());
+            if (result>0){
+                buffer->writeArray((const uint8_t*)data, result * frame_size);
+            }
+            return result;
+        }
+
+        /// Reads only whole frames: the result is a multiple of the frame size
+        size_t readBytes(uint8_t* data, size_t len){
+            return readFrames(data, len / frame_size) * frame_size;
+        }
+
+        /// Writes only whole frames: the result is a multiple of the frame size
+        size_t writeBytes(const uint8_t* data, size_t len){
+            return writeFrames(data, len / frame_size) * frame_size;
+        }
+
+    protected:
+        BaseBuffer<uint8_t> *buffer = nullptr;
+        int frame_size = 1;
+};
+
 } // namespace
@@ -2,6 +2,19 @@
 #include "AudioTypes.h"
 #include "Vector.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_CONVERTER_VECTOR16
+#endif
+
 namespace audio_tools {
 
 
@@ -18,11 +31,11 @@ static float convertFrom24ToFloat(int24_t value)  {
 }
 
 static int16_t convertFrom32To16(int32_t value)  {
-    return static_cast<float>(value) / INT32_MAX * INT16_MAX;
+    return value >> 16;
 }
 
 static int64_t maxValue(int value_bits_per_sample){
-    switch(value_bits_per_sample/8){
+    switch(value_bits_per_sample){
         case 8:
             return 127;
         case 16:
@@ -46,18 +59,500 @@ static int16_t convert8(int value, int value_bits_per_sample){
 }
 
 
+/**
+ * @brief Optimized processing of interleaved 16 and 32 bit samples which is used by the converters. We use AVX2, SSE2 
+ * or NEON if the target supports it. On Xtensa we process 2 16 bit samples in one 32 bit word. The gain is a fixed point 
+ * value (gain * 2^-shift) and all results are saturated: the optimized and the scalar implementations provide identical results.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ConverterKernel {
+    public:
+        /// Determines the fixed point representation (gain * 2^-shift) of the indicated factor for 16 bit samples:
+        /// the gain is limited to 14 bits, so that (sample + offset) * gain and the rounding fit into 32 bits
+        static void toFixedPoint(float factor, int16_t &gain, int &shift){
+            int64_t value;
+            toFixedPoint(factor, 16383, 30, value, shift);
+            gain = value;
+        }
+
+        /// Determines the fixed point representation (gain * 2^-shift) of the indicated factor for 32 bit samples:
+        /// the gain is limited to 30 bits, so that (sample + offset) * gain and the rounding fit into 64 bits
+        static void toFixedPoint(float factor, int32_t &gain, int &shift){
+            int64_t value;
+            toFixedPoint(factor, 1073741823, 62, value, shift);
+            gain = value;
+        }
+
+#ifdef USE_CONVERTER_VECTOR16
+#if defined(__AVX2__)
+        /// Register with 16 bit samples which is processed by the vector kernels
+        typedef __m256i Vector16;
+        static inline Vector16 load16(const int16_t *data) { return _mm256_loadu_si256((const __m256i*)data); }
+        static inline void store16(int16_t *data, Vector16 x) { _mm256_storeu_si256((__m256i*)data, x); }
+#elif defined(__SSE2__)
+        /// Register with 16 bit samples which is processed by the vector kernels
+        typedef __m128i Vector16;
+        static inline Vector16 load16(const int16_t *data) { return _mm_loadu_si128((const __m128i*)data); }
+        static inline void store16(int16_t *data, Vector16 x) { _mm_storeu_si128((__m128i*)data, x); }
+#else
+        /// Register with 16 bit samples which is processed by the vector kernels
+        typedef int16x8_t Vector16;
+        static inline Vector16 load16(const int16_t *data) { return vld1q_s16(data); }
+        static inline void store16(int16_t *data, Vector16 x) { vst1q_s16(data, x); }
+#endif
+        /// Number of 16 bit samples in a register: this is always a multiple of 2, so a register contains complete stereo frames
+        static inline size_t vector16Samples() { return sizeof(Vector16) / sizeof(int16_t); }
+
+        /// Vector kernel of scale(): the constants are prepared once, so that multiple kernels can be combined 
+        /// in one loop (see ConverterChain)
+        struct Scale16 {
+            Scale16(int16_t offset, int16_t gain, int shift, int16_t max) {
+#if defined(__AVX2__)
+                off = _mm256_set1_epi16(offset);
+                g = _mm256_set1_epi16(gain);
+                round = _mm256_set1_epi32(rounding(shift));
+                max_value = _mm256_set1_epi16(max);
+                min_value = _mm256_set1_epi16(-max);
+                count = _mm_cvtsi32_si128(shift);
+#elif defined(__SSE2__)
+                off = _mm_set1_epi16(offset);
+                g = _mm_set1_epi16(gain);
+                round = _mm_set1_epi32(rounding(shift));
+                max_value = _mm_set1_epi16(max);
+                min_value = _mm_set1_epi16(-max);
+                count = _mm_cvtsi32_si128(shift);
+#else
+                this->gain = gain;
+                base = vdupq_n_s32((int32_t)offset * gain + rounding(shift));
+                right_shift = vdupq_n_s32(-shift);
+                max_value = vdupq_n_s16(max);
+                min_value = vdupq_n_s16(-max);
+#endif
+            }
+
+            inline Vector16 vector(Vector16 x) const {
+#if defined(__AVX2__)
+                // x * gain + offset * gain + rounding
+                __m256i lo = _mm256_sra_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(x, off), g), round), count);
+                __m256i hi = _mm256_sra_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(x, off), g), round), count);
+                return _mm256_min_epi16(_mm256_max_epi16(_mm256_packs_epi32(lo, hi), min_value), max_value);
+#elif defined(__SSE2__)
+                __m128i lo = _mm_sra_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(x, off), g), round), count);
+                __m128i hi = _mm_sra_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(x, off), g), round), count);
+                return _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(lo, hi), min_value), max_value);
+#else
+                int32x4_t lo = vshlq_s32(vmlal_n_s16(base, vget_low_s16(x), gain), right_shift);
+                int32x4_t hi = vshlq_s32(vmlal_n_s16(base, vget_high_s16(x), gain), right_shift);
+                int16x8_t result = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+                return vminq_s16(vmaxq_s16(result, min_value), max_value);
+#endif
+            }
+
+        protected:
+#if defined(__SSE2__)
+            Vector16 off, g, round, max_value, min_value;
+            __m128i count;
+#else
+            int16_t gain;
+            int32x4_t base, right_shift;
+            int16x8_t max_value, min_value;
+#endif
+        };
+
+        /// Vector kernel of add()
+        struct Add16 {
+            Add16(int16_t value) {
+#if defined(__AVX2__)
+                v = _mm256_set1_epi16(value);
+#elif defined(__SSE2__)
+                v = _mm_set1_epi16(value);
+#else
+                v = vdupq_n_s16(value);
+#endif
+            }
+
+            inline Vector16 vector(Vector16 x) const {
+#if defined(__AVX2__)
+                return _mm256_adds_epi16(x, v);
+#elif defined(__SSE2__)
+                return _mm_adds_epi16(x, v);
+#else
+                return vqaddq_s16(x, v);
+#endif
+            }
+
+        protected:
+            Vector16 v;
+        };
+
+        /// Vector kernel of toUnsigned()
+        struct ToUnsigned16 {
+            ToUnsigned16() {
+#if defined(__AVX2__)
+                sign = _mm256_set1_epi16((int16_t)0x8000);
+#elif defined(__SSE2__)
+                sign = _mm_set1_epi16((int16_t)0x8000);
+#else
+                sign = vdupq_n_s16((int16_t)0x8000);
+#endif
+            }
+
+            inline Vector16 vector(Vector16 x) const {
+#if defined(__AVX2__)
+                return _mm256_xor_si256(x, sign);
+#elif defined(__SSE2__)
+                return _mm_xor_si128(x, sign);
+#else
+                return veorq_s16(x, sign);
+#endif
+            }
+
+        protected:
+            Vector16 sign;
+        };
+
+        /// Vector kernel of swap()
+        struct Swap16 {
+            inline Vector16 vector(Vector16 x) const {
+#if defined(__AVX2__)
+                return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+#elif defined(__SSE2__)
+                return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+#else
+                return vrev32q_s16(x);
+#endif
+            }
+        };
+
+        /// Vector kernel of fill(): copies the indicated channel (0 = left, 1 = right) to the other channel
+        struct Fill16 {
+            Fill16(int channel) {
+                this->channel = channel;
+#if !defined(__SSE2__)
+                // the lanes which are kept
+                static const uint16_t left[8] = {0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0};
+                mask = vld1q_u16(left);
+                if (channel==1) mask = vmvnq_u16(mask);
+#endif
+            }
+
+            inline Vector16 vector(Vector16 x) const {
+#if defined(__AVX2__)
+                return channel==0 ? _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,2,0,0))
+                                  : _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3,3,1,1)), _MM_SHUFFLE(3,3,1,1));
+#elif defined(__SSE2__)
+                return channel==0 ? _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,2,0,0))
+                                  : _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3,3,1,1)), _MM_SHUFFLE(3,3,1,1));
+#else
+                return vbslq_s16(mask, x, vrev32q_s16(x));
+#endif
+            }
+
+        protected:
+            int channel;
+#if !defined(__SSE2__)
+            uint16x8_t mask;
+#endif
+        };
+
+        /// Applies the vector kernel to the complete registers and returns the number of processed samples
+        template <typename Kernel>
+        static size_t applyVector16(const Kernel &kernel, int16_t *data, size_t samples){
+            size_t n = vector16Samples();
+            size_t j = 0;
+            for (; j+n<=samples; j+=n){
+                store16(data+j, kernel.vector(load16(data+j)));
+            }
+            return j;
+        }
+#endif
+
+        /// data[j] = ((data[j] + offset) * gain) >> shift rounded and limited to +-max
+        static void scale(int16_t *data, size_t samples, int16_t offset, int16_t gain, int shift, int16_t max){
+            size_t j = 0;
+#ifdef USE_CONVERTER_VECTOR16
+            j = applyVector16(Scale16(offset, gain, shift, max), data, samples);
+#endif
+            scaleScalar(data+j, samples-j, offset, gain, shift, max);
+        }
+
+        /// data[j] = ((data[j] + offset) * gain) >> shift rounded and limited to +-max: we use 64 bit integers
+        static void scale(int32_t *data, size_t samples, int32_t offset, int32_t gain, int shift, int32_t max){
+            scaleScalar(data, samples, offset, gain, shift, max);
+        }
+
+        /// data[j] = data[j] + value with saturation
+        static void add(int16_t *data, size_t samples, int16_t value){
+            size_t j = 0;
+#ifdef USE_CONVERTER_VECTOR16
+            j = applyVector16(Add16(value), data, samples);
+#endif
+            addScalar(data+j, samples-j, value);
+        }
+
+        /// data[j] = data[j] + value with saturation: we use 64 bit integers
+        static void add(int32_t *data, size_t samples, int32_t value){
+            addScalar(data, samples, value);
+        }
+
+        /// Converts signed to unsigned values by adding 0x8000 (e.g. for the internal DAC)
+        static void toUnsigned(int16_t *data, size_t samples){
+            size_t j = 0;
+#if defined(USE_CONVERTER_VECTOR16)
+            j = applyVector16(ToUnsigned16(), data, samples);
+#elif defined(__XTENSA__)
+            if (isWordAligned(data)){
+                uint32_t *words = (uint32_t*) data;
+                for (; j+2<=samples; j+=2){
+                    words[j/2] ^= 0x80008000;
+                }
+            }
+#endif
+            toUnsignedScalar(data+j, samples-j);
+        }
+
+        /// Switches the left and right channel of the indicated number of stereo frames
+        static void swap(int16_t *data, size_t frames){
+            size_t j = 0;
+#if defined(USE_CONVERTER_VECTOR16)
+            j = applyVector16(Swap16(), data, frames*2) / 2;
+#elif defined(__XTENSA__)
+            if (isWordAligned(data)){
+                uint32_t *words = (uint32_t*) data;
+                for (; j<frames; j++){
+                    words[j] = (words[j] << 16) | (words[j] >> 16);
+                }
+            }
+#endif
+            swapScalar(data+j*2, frames-j);
+        }
+
+        /// Switches the left and right channel of the indicated number of stereo frames
+        static void swap(int32_t *data, size_t frames){
+            size_t j = 0;
+#if defined(__SSE2__)
+#if defined(__AVX2__)
+            for (; j+4<=frames; j+=4){
+                __m256i *ptr = (__m256i*)(data+j*2);
+                _mm256_storeu_si256(ptr, _mm256_shuffle_epi32(_mm256_loadu_si256(ptr), _MM_SHUFFLE(2,3,0,1)));
+            }
+#endif
+            for (; j+2<=frames; j+=2){
+                __m128i *ptr = (__m128i*)(data+j*2);
+                _mm_storeu_si128(ptr, _mm_shuffle_epi32(_mm_loadu_si128(ptr), _MM_SHUFFLE(2,3,0,1)));
+            }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            for (; j+2<=frames; j+=2){
+                vst1q_s32(data+j*2, vrev64q_s32(vld1q_s32(data+j*2)));
+            }
+#endif
+            swapScalar(data+j*2, frames-j);
+        }
+
+        /// Copies the indicated channel (0 = left, 1 = right) to the other channel of the stereo frames
+        static void fill(int16_t *data, size_t frames, int channel){
+            size_t j = 0;
+#if defined(USE_CONVERTER_VECTOR16)
+            j = applyVector16(Fill16(channel), data, frames*2) / 2;
+#elif defined(__XTENSA__)
+            // the left channel is in the lower half of the little endian word
+            if (isWordAligned(data)){
+                uint32_t *words = (uint32_t*) data;
+                for (; j<frames; j++){
+                    uint32_t value = channel==0 ? words[j] & 0xFFFF : words[j] >> 16;
+                    words[j] = value | (value << 16);
+                }
+            }
+#endif
+            fillScalar(data+j*2, frames-j, channel);
+        }
+
+        /// Copies the indicated channel (0 = left, 1 = right) to the other channel of the stereo frames
+        static void fill(int32_t *data, size_t frames, int channel){
+            size_t j = 0;
+#if defined(__SSE2__)
+#if defined(__AVX2__)
+            for (; j+4<=frames; j+=4){
+                __m256i *ptr = (__m256i*)(data+j*2);
+                __m256i x = _mm256_loadu_si256(ptr);
+                x = channel==0 ? _mm256_shuffle_epi32(x, _MM_SHUFFLE(2,2,0,0)) : _mm256_shuffle_epi32(x, _MM_SHUFFLE(3,3,1,1));
+                _mm256_storeu_si256(ptr, x);
+            }
+#endif
+            for (; j+2<=frames; j+=2){
+                __m128i *ptr = (__m128i*)(data+j*2);
+                __m128i x = _mm_loadu_si128(ptr);
+                x = channel==0 ? _mm_shuffle_epi32(x, _MM_SHUFFLE(2,2,0,0)) : _mm_shuffle_epi32(x, _MM_SHUFFLE(3,3,1,1));
+                _mm_storeu_si128(ptr, x);
+            }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            for (; j+4<=frames; j+=4){
+                int32x4x2_t x = vld2q_s32(data+j*2);
+                x.val[1-channel] = x.val[channel];
+                vst2q_s32(data+j*2, x);
+            }
+#endif
+            fillScalar(data+j*2, frames-j, channel);
+        }
+
+        /// Scalar implementation of scale()
+        template <typename T>
+        static void scaleScalar(T *data, size_t samples, T offset, int32_t gain, int shift, T max){
+            for (size_t j=0;j<samples;j++){
+                data[j] = scaleSample(data[j], offset, gain, shift, max);
+            }
+        }
+
+        /// Scalar implementation of scale() for 16 bit: we can use 32 bit integers
+        static void scaleScalar(int16_t *data, size_t samples, int16_t offset, int16_t gain, int shift, int16_t max){
+            for (size_t j=0;j<samples;j++){
+                data[j] = scaleSample(data[j], offset, gain, shift, max);
+            }
+        }
+
+        /// Scalar implementation of add()
+        template <typename T>
+        static void addScalar(T *data, size_t samples, T value){
+            for (size_t j=0;j<samples;j++){
+                data[j] = addSample(data[j], value);
+            }
+        }
+
+        /// scale() for a single sample
+        template <typename T>
+        static inline T scaleSample(T sample, T offset, int32_t gain, int shift, T max){
+            int64_t value = (((int64_t)sample + offset) * gain + (shift > 0 ? (int64_t)1 << (shift - 1) : 0)) >> shift;
+            return value > max ? max : (value < -max ? -max : value);
+        }
+
+        /// scale() for a single 16 bit sample
+        static inline int16_t scaleSample(int16_t sample, int16_t offset, int16_t gain, int shift, int16_t max){
+            int32_t value = ((int32_t)sample * gain + (int32_t)offset * gain + rounding(shift)) >> shift;
+            return value > max ? max : (value < -max ? -max : value);
+        }
+
+        /// add() for a single sample
+        static inline int16_t addSample(int16_t sample, int16_t value){
+            int32_t result = (int32_t)sample + value;
+            return result > 32767 ? 32767 : (result < -32768 ? -32768 : result);
+        }
+
+        /// add() for a single sample
+        static inline int32_t addSample(int32_t sample, int32_t value){
+            int64_t result = (int64_t)sample + value;
+            return result > INT32_MAX ? INT32_MAX : (result < INT32_MIN ? INT32_MIN : result);
+        }
+
+        /// Scalar implementation of toUnsigned()
+        static void toUnsignedScalar(int16_t *data, size_t samples){
+            for (size_t j=0;j<samples;j++){
+                data[j] ^= (int16_t)0x8000;
+            }
+        }
+
+        /// Scalar implementation of swap()
+        template <typename T>
+        static void swapScalar(T *data, size_t frames){
+            for (size_t j=0;j<frames;j++){
+                T tmp = data[j*2];
+                data[j*2] = data[j*2+1];
+                data[j*2+1] = tmp;
+            }
+        }
+
+        /// Scalar implementation of fill()
+        template <typename T>
+        static void fillScalar(T *data, size_t frames, int channel){
+            for (size_t j=0;j<frames;j++){
+                data[j*2+1-channel] = data[j*2+channel];
+            }
+        }
+
+    protected:
+        static bool isWordAligned(void *ptr) {
+            return ((uintptr_t)ptr & 3) == 0;
+        }
+
+        /// 0.5 in the fixed point representation, so that the result is rounded to the nearest value
+        static inline int32_t rounding(int shift) {
+            return shift > 0 ? 1 << (shift - 1) : 0;
+        }
+
+        /// the biggest shift which keeps |gain| <= maxGain
+        static void toFixedPoint(float factor, int64_t maxGain, int maxShift, int64_t &gain, int &shift){
+            double value = fabs(factor);
+            shift = 0;
+            while (shift < maxShift && value * 2.0 <= maxGain){
+                value *= 2.0;
+                shift++;
+            }
+            value = value > maxGain ? maxGain : value;
+            gain = (int64_t)(value + 0.5);
+            if (factor < 0) gain = -gain;
+        }
+};
+
+
+/// Memory layout of multi channel data: frame by frame (interleaved) or channel by channel (planar)
+enum ChannelLayout {CHANNELS_INTERLEAVED, CHANNELS_PLANAR};
+
+/**
+ * @brief Abstract Base class for Converters which process blocks of any number of channels
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T 
+ */
+template<typename T>
+class MultiChannelConverter {
+    public:
+        virtual ~MultiChannelConverter() = default;
+        /// Processes the indicated number of frames: in planar layout the data of channel ch starts at data + ch * frames
+        virtual void convertBlock(T *data, size_t frames, int channels, ChannelLayout layout=CHANNELS_INTERLEAVED) = 0;
+};
 
 /**
  * @brief Abstract Base class for Converters
- * A converter is processing the data in the indicated array
+ * A converter is processing the data in the indicated array. Other channel counts are supported by convertBlock(): 
+ * per default the channels are passed to convert() in pairs, a single remaining channel is used as left and right channel.
+ * Interleaved stereo data is passed on w/o copying.
  * @author Phil Schatzmann
  * @copyright GPLv3
  * @tparam T 
  */
 template<typename T>
-class BaseConverter {
+class BaseConverter : public MultiChannelConverter<T> {
     public:
         virtual void convert(T (*src)[2], size_t size) = 0;
+
+        virtual void convertBlock(T *data, size_t frames, int channels, ChannelLayout layout=CHANNELS_INTERLEAVED) {
+            if (channels==2 && layout==CHANNELS_INTERLEAVED){
+                convert((T(*)[2])data, frames);
+                return;
+            }
+            const size_t chunk_frames = 64;
+            T pair[chunk_frames][2];
+            for (size_t start=0; start<frames; start+=chunk_frames){
+                size_t len = MIN(chunk_frames, frames - start);
+                for (int ch=0; ch<channels; ch+=2){
+                    int right = ch+1 < channels ? ch+1 : ch;
+                    for (size_t j=0;j<len;j++){
+                        pair[j][0] = data[index(start+j, ch, frames, channels, layout)];
+                        pair[j][1] = data[index(start+j, right, frames, channels, layout)];
+                    }
+                    convert(pair, len);
+                    for (size_t j=0;j<len;j++){
+                        data[index(start+j, ch, frames, channels, layout)] = pair[j][0];
+                        data[index(start+j, right, frames, channels, layout)] = pair[j][1];
+                    }
+                }
+            }
+        }
+
+    protected:
+        static size_t index(size_t frame, int channel, size_t frames, int channels, ChannelLayout layout){
+            return layout==CHANNELS_INTERLEAVED ? frame * channels + channel : channel * frames + frame;
+        }
 };
 
 
@@ -70,10 +565,22 @@ template<typename T>
 class NOPConverter : public  BaseConverter<T> {
     public:
         virtual void convert(T (*src)[2], size_t size) {};
+        virtual void convertBlock(T *data, size_t frames, int channels, ChannelLayout layout=CHANNELS_INTERLEAVED) {};
+        bool isReady() { return true; }
+
+        /// Kernel which does nothing: used by the ConverterChain
+        struct FrameKernel {
+            inline void frame(T *frame) const {}
+#ifdef USE_CONVERTER_VECTOR16
+            inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const { return x; }
+#endif
+        };
+        FrameKernel frameKernel() { return FrameKernel(); }
 };
 
 /**
- * @brief Multiplies the values with the indicated factor adds the offset and clips at maxValue. To mute use a factor of 0.0!
+ * @brief Adds the offset, multiplies the values with the indicated factor and clips at maxValue. To mute use a factor of 0.0!
+ * 16 and 32 bit values are processed with a fixed point factor by the ConverterKernel.
  * @author Phil Schatzmann
  * @copyright GPLv3
  * 
@@ -82,32 +589,113 @@ class NOPConverter : public  BaseConverter<T> {
 template<typename T>
 class ConverterScaler : public  BaseConverter<T> {
     public:
+        /// Copy of the parameters which scales a stereo frame or a register of 16 bit samples: used by the ConverterChain
+        struct FrameKernel {
+            FrameKernel(const ConverterScaler &scaler)
+#ifdef USE_CONVERTER_VECTOR16
+                : vector16(scaler.offset, scaler.gain16, scaler.shift16, scaler.maxValue)
+#endif
+            {
+                factor = scaler.factor;
+                maxValue = scaler.maxValue;
+                offset = scaler.offset;
+                gain16 = scaler.gain16;
+                shift16 = scaler.shift16;
+                gain32 = scaler.gain32;
+                shift32 = scaler.shift32;
+            }
+
+            inline void frame(T *frame) const {
+                frame[0] = sample(frame[0]);
+                frame[1] = sample(frame[1]);
+            }
+
+#ifdef USE_CONVERTER_VECTOR16
+            /// Only used for 16 bit samples
+            inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const {
+                return vector16.vector(x);
+            }
+#endif
+
+            inline int16_t sample(int16_t sample) const {
+                return ConverterKernel::scaleSample(sample, (int16_t)offset, gain16, shift16, (int16_t)maxValue);
+            }
+
+            inline int32_t sample(int32_t sample) const {
+                return ConverterKernel::scaleSample(sample, (int32_t)offset, gain32, shift32, (int32_t)maxValue);
+            }
+
+            template<typename U>
+            inline U sample(U sample) const {
+                U value = (sample + offset) * factor;
+                if (value>maxValue){
+                    value = maxValue;
+                } else if (value<-maxValue){
+                    value = -maxValue;
+                }
+                return value;
+            }
+
+        protected:
+            float factor;
+            T maxValue;
+            T offset;
+            int16_t gain16;
+            int shift16;
+            int32_t gain32;
+            int shift32;
+#ifdef USE_CONVERTER_VECTOR16
+            ConverterKernel::Scale16 vector16;
+#endif
+        };
+
         ConverterScaler(float factor, T offset, T maxValue){
             this->factor = factor;
             this->maxValue = maxValue;
             this->offset = offset;
+            ConverterKernel::toFixedPoint(factor, gain16, shift16);
+            ConverterKernel::toFixedPoint(factor, gain32, shift32);
         }
 
         void convert(T (*src)[2], size_t size) {
-            for (size_t j=0;j<size;j++){
-                src[j][0] = (src[j][0] + offset) * factor;
-                if (src[j][0]>maxValue){
-                    src[j][0] = maxValue;
-                } else if (src[j][0]<-maxValue){
-                    src[j][0] = -maxValue;
-                }
-                src[j][1] = src[j][1] + offset * factor;
-                if (src[j][1]>maxValue){
-                    src[j][1] = maxValue;
-                } else if (src[j][0]<-maxValue){
-                    src[j][1] = -maxValue;
-                }
-            }
+            scale((T*)src, size*2);
         }
+
+        /// All samples are processed the same way, so the layout does not matter
+        void convertBlock(T *data, size_t frames, int channels, ChannelLayout layout=CHANNELS_INTERLEAVED) {
+            scale(data, frames*channels);
+        }
+
+        /// Used by the ConverterChain
+        bool isReady() { return true; }
+
+        /// Used by the ConverterChain
+        FrameKernel frameKernel() { return FrameKernel(*this); }
+
     protected:
         float factor;
         T maxValue;
         T offset;
+        int16_t gain16;
+        int shift16;
+        int32_t gain32;
+        int shift32;
+
+        void scale(int16_t *data, size_t samples) {
+            ConverterKernel::scale(data, samples, offset, gain16, shift16, maxValue);
+        }
+
+        void scale(int32_t *data, size_t samples) {
+            ConverterKernel::scale(data, samples, offset, gain32, shift32, maxValue);
+        }
+
+        template<typename U>
+        void scale(U *data, size_t samples) {
+            FrameKernel kernel(*this);
+            for (size_t j=0;j<samples;j++){
+                data[j] = kernel.sample(data[j]);
+            }
+        }
 };
 
 /**
@@ -118,25 +706,86 @@ class ConverterScaler : public  BaseConverter<T> {
 template<typename T>
 class ConverterAutoCenter : public  BaseConverter<T> {
     public:
+        /// Copy of the offset which centers a stereo frame or a register of 16 bit samples: used by the ConverterChain
+        struct FrameKernel {
+            FrameKernel(T offset)
+#ifdef USE_CONVERTER_VECTOR16
+                : vector16(-offset)
+#endif
+            {
+                this->offset = offset;
+            }
+
+            inline void frame(T *frame) const {
+                frame[0] = sample(frame[0]);
+                frame[1] = sample(frame[1]);
+            }
+
+#ifdef USE_CONVERTER_VECTOR16
+            /// Only used for 16 bit samples
+            inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const {
+                return vector16.vector(x);
+            }
+#endif
+
+            inline int16_t sample(int16_t sample) const {
+                return ConverterKernel::addSample(sample, (int16_t)-offset);
+            }
+
+            inline int32_t sample(int32_t sample) const {
+                return ConverterKernel::addSample(sample, (int32_t)-offset);
+            }
+
+            template<typename U>
+            inline U sample(U sample) const {
+                return sample - offset;
+            }
+
+        protected:
+            T offset;
+#ifdef USE_CONVERTER_VECTOR16
+            ConverterKernel::Add16 vector16;
+#endif
+        };
+
         ConverterAutoCenter(){
         }
 
         void convert(T (*src)[2], size_t size) {
             setup(src, size);
             if (is_setup){
-                for (size_t j=0; j<size; j++){
-                    src[j][0] = src[j][0] - offset;
-                    src[j][1] = src[j][1] - offset;
-                }
+                center(src, size);
             }
         }
 
+        /// The offset is determined from the first block: used by the ConverterChain
+        bool isReady() { return is_setup; }
+
+        /// Used by the ConverterChain
+        FrameKernel frameKernel() { return FrameKernel(offset); }
+
     protected:
         T offset;
-        float left;
-        float right;
+        float left = 0;
+        float right = 0;
         bool is_setup = false;
 
+        void center(int16_t (*src)[2], size_t size) {
+            ConverterKernel::add((int16_t*)src, size*2, -offset);
+        }
+
+        void center(int32_t (*src)[2], size_t size) {
+            ConverterKernel::add((int32_t*)src, size*2, -offset);
+        }
+
+        template<typename U>
+        void center(U (*src)[2], size_t size) {
+            FrameKernel kernel(offset);
+            for (size_t j=0; j<size; j++){
+                kernel.frame(src[j]);
+            }
+        }
+
         void setup(T (*src)[2], size_t size){
             if (!is_setup) {
                 for (size_t j=0;j<size;j++){
@@ -170,10 +819,43 @@ class ConverterSwitchLeftAndRight : public  BaseConverter<T> {
         ConverterSwitchLeftAndRight(){
         }
         void convert(T (*src)[2], size_t size) {
-            for (size_t j=0;j<size;j++){
-                src[j][1] = src[j][0];
-                src[j][0] = src[j][1];
+            swap(src, size);
+        }
+
+        /// Used by the ConverterChain
+        bool isReady() { return true; }
+
+        /// Switches the channels of a stereo frame or of a register of 16 bit samples: used by the ConverterChain
+        struct FrameKernel {
+            inline void frame(T *frame) const {
+                T tmp = frame[0];
+                frame[0] = frame[1];
+                frame[1] = tmp;
             }
+
+#ifdef USE_CONVERTER_VECTOR16
+            /// Only used for 16 bit samples
+            inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const {
+                return ConverterKernel::Swap16().vector(x);
+            }
+#endif
+        };
+
+        /// Used by the ConverterChain
+        FrameKernel frameKernel() { return FrameKernel(); }
+
+    protected:
+        void swap(int16_t (*src)[2], size_t size) {
+            ConverterKernel::swap((int16_t*)src, size);
+        }
+
+        void swap(int32_t (*src)[2], size_t size) {
+            ConverterKernel::swap((int32_t*)src, size);
+        }
+
+        template<typename U>
+        void swap(U (*src)[2], size_t size) {
+            ConverterKernel::swapScalar((U*)src, size);
         }
 };
 
@@ -213,14 +895,51 @@ class ConverterFillLeftAndRight : public  BaseConverter<T> {
         void convert(T (*src)[2], size_t size) {
             setup(src, size);
             if (left_empty && !right_empty){
-                for (size_t j=0;j<size;j++){
-                    src[j][0] = src[j][1];
-                }
+                fill(src, size, 1);
             } else if (!left_empty && right_empty) {
-                for (size_t j=0;j<size;j++){
-                    src[j][1] = src[j][0];
+                fill(src, size, 0);
+            }
+        }
+
+        /// The empty channel is determined from the data in Auto mode: used by the ConverterChain
+        bool isReady() { return is_setup; }
+
+        /// Copies the channel with the data (-1 = none) of a stereo frame or of a register of 16 bit samples: 
+        /// used by the ConverterChain
+        struct FrameKernel {
+            FrameKernel(int channel)
+#ifdef USE_CONVERTER_VECTOR16
+                : vector16(channel < 0 ? 0 : channel)
+#endif
+            {
+                this->channel = channel;
+            }
+
+            inline void frame(T *frame) const {
+                if (channel>=0){
+                    frame[1-channel] = frame[channel];
                 }
             }
+
+#ifdef USE_CONVERTER_VECTOR16
+            /// Only used for 16 bit samples
+            inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const {
+                return channel < 0 ? x : vector16.vector(x);
+            }
+#endif
+
+        protected:
+            int channel;
+#ifdef USE_CONVERTER_VECTOR16
+            ConverterKernel::Fill16 vector16;
+#endif
+        };
+
+        /// Used by the ConverterChain
+        FrameKernel frameKernel() { 
+            if (left_empty && !right_empty) return FrameKernel(1);
+            if (!left_empty && right_empty) return FrameKernel(0);
+            return FrameKernel(-1);
         }
 
     private:
@@ -249,6 +968,19 @@ class ConverterFillLeftAndRight : public  BaseConverter<T> {
             }
         }
 
+        void fill(int16_t (*src)[2], size_t size, int channel) {
+            ConverterKernel::fill((int16_t*)src, size, channel);
+        }
+
+        void fill(int32_t (*src)[2], size_t size, int channel) {
+            ConverterKernel::fill((int32_t*)src, size, channel);
+        }
+
+        template<typename U>
+        void fill(U (*src)[2], size_t size, int channel) {
+            ConverterKernel::fillScalar((U*)src, size, channel);
+        }
+
 };
 
 /**
@@ -266,15 +998,56 @@ class ConverterToInternalDACFormat : public  BaseConverter<T> {
         }
 
         void convert(T (*src)[2], size_t size) {
-            for (int i=0; i<size; i++) {
-                src[i][0] = src[i][0] + 0x8000;
-                src[i][1] = src[i][1] + 0x8000;
+            toUnsigned((T*)src, size*2);
+        }
+
+        /// All samples are processed the same way, so the layout does not matter
+        void convertBlock(T *data, size_t frames, int channels, ChannelLayout layout=CHANNELS_INTERLEAVED) {
+            toUnsigned(data, frames*channels);
+        }
+
+        /// Used by the ConverterChain
+        bool isReady() { return true; }
+
+        /// Converts a stereo frame or a register of 16 bit samples: used by the ConverterChain
+        struct FrameKernel {
+            inline void frame(T *frame) const {
+                frame[0] = frame[0] + 0x8000;
+                frame[1] = frame[1] + 0x8000;
+            }
+
+#ifdef USE_CONVERTER_VECTOR16
+            /// Only used for 16 bit samples
+            inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const {
+                return vector16.vector(x);
+            }
+
+            ConverterKernel::ToUnsigned16 vector16;
+#endif
+        };
+
+        /// Used by the ConverterChain
+        FrameKernel frameKernel() { return FrameKernel(); }
+
+    protected:
+        void toUnsigned(int16_t *data, size_t samples) {
+            ConverterKernel::toUnsigned(data, samples);
+        }
+
+        template<typename U>
+        void toUnsigned(U *data, size_t samples) {
+            for (size_t i=0; i<samples; i++) {
+                data[i] = data[i] + 0x8000;
             }
         }
 };
 
 /**
- * @brief Combines multiple converters
+ * @brief Combines multiple converters which are defined at runtime: the converters are applied one after the
+ * other to the whole block, so there is one virtual call per converter and block. Use the ConverterChain if the
+ * converters are known at compile time: it applies all converters in a single pass.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
  * 
  * @tparam T 
  */
@@ -286,21 +1059,140 @@ class MultiConverter : public BaseConverter<T> {
 
         // adds a converter
         void add(BaseConverter<T> &converter){
-            converters.push_back(converter);
+            converters.push_back(&converter);
         }
 
-        // The data is provided as int24_t tgt[][2] but  returned as int24_t
         void convert(T (*src)[2], size_t size) {
             for(int i=0; i < converters.size(); i++){
-                converters[i].convert(src);
+                converters[i]->convert(src, size);
+            }
+        }
+
+        void convertBlock(T *data, size_t frames, int channels, ChannelLayout layout=CHANNELS_INTERLEAVED) {
+            for(int i=0; i < converters.size(); i++){
+                converters[i]->convertBlock(data, frames, channels, layout);
             }
         }
 
     private:
-        Vector<T> converters;
+        Vector<BaseConverter<T>*> converters;
 
 };
 
+/// The stages of a ConverterChain: the empty chain does nothing
+template<typename T, typename... Converters>
+struct ConverterChainStages {
+    /// The kernels of all stages
+    struct Kernels {
+        inline void frame(T *frame) const {}
+#ifdef USE_CONVERTER_VECTOR16
+        inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const { return x; }
+#endif
+    };
+
+    bool isReady() { return true; }
+    Kernels kernels() { return Kernels(); }
+    void convert(T (*src)[2], size_t size) {}
+};
+
+/// The stages of a ConverterChain: the first converter is called directly, so that it can be inlined
+template<typename T, typename First, typename... Rest>
+struct ConverterChainStages<T, First, Rest...> {
+    /// The kernels of all stages: they are local copies, so that the compiler can keep the parameters in registers
+    struct Kernels {
+        typename First::FrameKernel first;
+        typename ConverterChainStages<T, Rest...>::Kernels rest;
+
+        inline void frame(T *frame) const {
+            first.frame(frame);
+            rest.frame(frame);
+        }
+
+#ifdef USE_CONVERTER_VECTOR16
+        inline ConverterKernel::Vector16 vector(ConverterKernel::Vector16 x) const {
+            return rest.vector(first.vector(x));
+        }
+#endif
+    };
+
+    ConverterChainStages(First &first, Rest&... rest) : first(&first), rest(rest...) {}
+
+    bool isReady() {
+        return first->isReady() && rest.isReady();
+    }
+
+    Kernels kernels() {
+        Kernels result = {first->frameKernel(), rest.kernels()};
+        return result;
+    }
+
+    void convert(T (*src)[2], size_t size) {
+        first->convert(src, size);
+        rest.convert(src, size);
+    }
+
+    First *first;
+    ConverterChainStages<T, Rest...> rest;
+};
+
+/**
+ * @brief Combines converters which are known at compile time into a single pass: all converters are applied to a 
+ * frame before we move on to the next one. For 16 bit samples we process a whole register of frames (AVX2, SSE2 or NEON), 
+ * so that the data is loaded and stored only once for all converters. The converters must provide isReady() and 
+ * frameKernel(): as long as a converter is not ready (e.g. the ConverterAutoCenter needs to determine the offset first) 
+ * the converters are applied one after the other to the whole block. 
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * 
+ * @tparam T 
+ * @tparam Converters
+ */
+template<typename T, typename... Converters>
+class ConverterChain : public BaseConverter<T> {
+    public:
+        ConverterChain(Converters&... converters) : stages(converters...) {
+        }
+
+        void convert(T (*src)[2], size_t size) {
+            if (!stages.isReady()){
+                stages.convert(src, size);
+                return;
+            }
+            Kernels kernels = stages.kernels();
+            convertFused(kernels, (T*)src, size);
+        }
+
+    protected:
+        typedef typename ConverterChainStages<T, Converters...>::Kernels Kernels;
+        ConverterChainStages<T, Converters...> stages;
+
+        void convertFused(const Kernels &kernels, int16_t *data, size_t frames) {
+            size_t j = 0;
+#ifdef USE_CONVERTER_VECTOR16
+            size_t n = ConverterKernel::vector16Samples();
+            for (; j+n<=frames*2; j+=n){
+                ConverterKernel::store16(data+j, kernels.vector(ConverterKernel::load16(data+j)));
+            }
+#endif
+            for (; j<frames*2; j+=2){
+                kernels.frame(data+j);
+            }
+        }
+
+        template<typename U>
+        void convertFused(const Kernels &kernels, U *data, size_t frames) {
+            for (size_t j=0; j<frames*2; j+=2){
+                kernels.frame(data+j);
+            }
+        }
+};
+
+/// Creates a ConverterChain e.g. auto chain = converterChain<int16_t>(center, scaler, dac);
+template<typename T, typename... Converters>
+ConverterChain<T, Converters...> converterChain(Converters&... converters) {
+    return ConverterChain<T, Converters...>(converters...);
+}
+
 /**
  * @brief Converts e.g. 24bit data to the indicated bigger data type
  * @author Phil Schatzmann
@@ -389,9 +1281,9 @@ class NumberReader {
     protected:
         Stream *stream_ptr=nullptr;
 
-        /// scale the value
+        /// scale the value with shifts
         int32_t scale(int32_t value, int inBits, int outBits, bool outSigned=true){
-            int32_t result = static_cast<float>(value) / maxValue(inBits) * maxValue(outBits);
+            int32_t result = inBits > outBits ? value >> (inBits - outBits) : value * (1 << (outBits - inBits));
             if (!outSigned){
                 result += (maxValue(outBits) / 2);
             }
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/Allocator.h"
+
+namespace audio_tools {
+
+/// Supported sample formats: S24_IN_32 is a sign extended 24 bit value in the lower 3 bytes of an int32_t
+enum SampleFormat {FORMAT_U8, FORMAT_S8, FORMAT_S16, FORMAT_S24_PACKED, FORMAT_S24_IN_32, FORMAT_S32, FORMAT_FLOAT};
+
+/**
+ * @brief Conversion of a sample format from and to a left aligned int32_t (full scale). The data is accessed with
+ * memcpy, so it does not need to be aligned.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <SampleFormat F>
+struct SampleFormatTraits;
+
+template <>
+struct SampleFormatTraits<FORMAT_U8> {
+    typedef uint8_t type;
+    static const int size = 1;
+    static inline int32_t toInt32(type value) { return ((int32_t)value - 128) * 16777216; }
+    static inline type fromInt32(int32_t value) { return (value >> 24) + 128; }
+    static inline int32_t toInt32(const uint8_t *p) { return toInt32(p[0]); }
+    static inline void fromInt32(int32_t value, uint8_t *p) { p[0] = fromInt32(value); }
+};
+
+template <>
+struct SampleFormatTraits<FORMAT_S8> {
+    typedef int8_t type;
+    static const int size = 1;
+    static inline int32_t toInt32(type value) { return (int32_t)value * 16777216; }
+    static inline type fromInt32(int32_t value) { return value >> 24; }
+    static inline int32_t toInt32(const uint8_t *p) { return toInt32((type)p[0]); }
+    static inline void fromInt32(int32_t value, uint8_t *p) { p[0] = fromInt32(value); }
+};
+
+template <>
+struct SampleFormatTraits<FORMAT_S16> {
+    typedef int16_t type;
+    static const int size = 2;
+    static inline int32_t toInt32(type value) { return (int32_t)value * 65536; }
+    static inline type fromInt32(int32_t value) { return value >> 16; }
+    static inline int32_t toInt32(const uint8_t *p) {
+        type value;
+        memcpy(&value, p, sizeof(value));
+        return toInt32(value);
+    }
+    static inline void fromInt32(int32_t value, uint8_t *p) {
+        type result = fromInt32(value);
+        memcpy(p, &result, sizeof(result));
+    }
+};
+
+/// little endian 3 bytes: there is no native type, so the data is always processed byte by byte
+template <>
+struct SampleFormatTraits<FORMAT_S24_PACKED> {
+    typedef void type;
+    static const int size = 3;
+    static inline int32_t toInt32(const uint8_t *p) {
+        return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+    }
+    static inline void fromInt32(int32_t value, uint8_t *p) {
+        p[0] = value >> 8;
+        p[1] = value >> 16;
+        p[2] = value >> 24;
+    }
+    /// converts 4 samples (12 bytes) with 3 word loads
+    static inline void toInt32x4(const uint8_t *p, int32_t *out) {
+        uint32_t w[3];
+        memcpy(w, p, sizeof(w));
+        out[0] = (int32_t)(w[0] << 8);
+        out[1] = (int32_t)(((w[0] >> 24) << 8) | (w[1] << 16));
+        out[2] = (int32_t)(((w[1] >> 8) & 0xFFFF00) | (w[2] << 24));
+        out[3] = (int32_t)(w[2] & 0xFFFFFF00);
+    }
+};
+
+template <>
+struct SampleFormatTraits<FORMAT_S24_IN_32> {
+    typedef int32_t type;
+    static const int size = 4;
+    static inline int32_t toInt32(type value) { return value * 256; }
+    static inline type fromInt32(int32_t value) { return value >> 8; }
+    static inline int32_t toInt32(const uint8_t *p) {
+        type value;
+        memcpy(&value, p, sizeof(value));
+        return toInt32(value);
+    }
+    static inline void fromInt32(int32_t value, uint8_t *p) {
+        type result = fromInt32(value);
+        memcpy(p, &result, sizeof(result));
+    }
+};
+
+template <>
+struct SampleFormatTraits<FORMAT_S32> {
+    typedef int32_t type;
+    static const int size = 4;
+    static inline int32_t toInt32(type value) { return value; }
+    static inline type fromInt32(int32_t value) { return value; }
+    static inline int32_t toInt32(const uint8_t *p) {
+        type value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    static inline void fromInt32(int32_t value, uint8_t *p) {
+        memcpy(p, &value, sizeof(value));
+    }
+};
+
+/// values between -1.0 and 1.0: values outside of this range are clipped
+template <>
+struct SampleFormatTraits<FORMAT_FLOAT> {
+    typedef float type;
+    static const int size = 4;
+    static inline int32_t toInt32(type value) {
+        value *= 2147483648.0f;
+        return value >= 2147483647.0f ? 2147483647 : (value <= -2147483648.0f ? (-2147483647 - 1) : (int32_t) value);
+    }
+    static inline type fromInt32(int32_t value) { return value * (1.0f / 2147483648.0f); }
+    static inline int32_t toInt32(const uint8_t *p) {
+        type value;
+        memcpy(&value, p, sizeof(value));
+        return toInt32(value);
+    }
+    static inline void fromInt32(int32_t value, uint8_t *p) {
+        type result = fromInt32(value);
+        memcpy(p, &result, sizeof(result));
+    }
+};
+
+/// Function which converts the indicated number of samples
+typedef void (*FormatKernelFunction)(const uint8_t *in, uint8_t *out, size_t samples);
+
+/**
+ * @brief Converts the samples byte by byte: this is used for the packed 24 bit format and unaligned data
+ */
+template <SampleFormat From, SampleFormat To>
+struct FormatKernelBytes {
+    static void convert(const uint8_t *in, uint8_t *out, size_t samples) {
+        typedef SampleFormatTraits<From> in_format;
+        typedef SampleFormatTraits<To> out_format;
+        for (size_t j=0;j<samples;j++){
+            out_format::fromInt32(in_format::toInt32(in + j*in_format::size), out + j*out_format::size);
+        }
+    }
+};
+
+/**
+ * @brief Converts the samples from one format to the other. Each pair of formats is a separate instance, so
+ * that the conversion is a simple integer shift/multiply loop which can be vectorized by the compiler.
+ * In and out may be identical if the output sample size is not bigger than the input sample size.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <SampleFormat From, SampleFormat To>
+struct FormatKernel {
+    static void convert(const uint8_t *in, uint8_t *out, size_t samples) {
+        typedef SampleFormatTraits<From> in_format;
+        typedef SampleFormatTraits<To> out_format;
+        // in place and unaligned data is processed byte by byte, so that the typed pointers can not alias
+        if (in==out || !isAligned(in, in_format::size) || !isAligned(out, out_format::size)){
+            FormatKernelBytes<From, To>::convert(in, out, samples);
+            return;
+        }
+        convertTyped((const typename in_format::type *) in, (typename out_format::type *) out, samples);
+    }
+
+    static void convertTyped(const typename SampleFormatTraits<From>::type *__restrict in, typename SampleFormatTraits<To>::type *__restrict out, size_t samples) {
+        typedef SampleFormatTraits<From> in_format;
+        typedef SampleFormatTraits<To> out_format;
+        size_t j = 0;
+        // blocks of 8 samples are vectorized by the compiler (SLP) even if the loop vectorizer is not active
+        for (; j+8<=samples; j+=8){
+            out[j] = out_format::fromInt32(in_format::toInt32(in[j]));
+            out[j+1] = out_format::fromInt32(in_format::toInt32(in[j+1]));
+            out[j+2] = out_format::fromInt32(in_format::toInt32(in[j+2]));
+            out[j+3] = out_format::fromInt32(in_format::toInt32(in[j+3]));
+            out[j+4] = out_format::fromInt32(in_format::toInt32(in[j+4]));
+            out[j+5] = out_format::fromInt32(in_format::toInt32(in[j+5]));
+            out[j+6] = out_format::fromInt32(in_format::toInt32(in[j+6]));
+            out[j+7] = out_format::fromInt32(in_format::toInt32(in[j+7]));
+        }
+        for (; j<samples; j++){
+            out[j] = out_format::fromInt32(in_format::toInt32(in[j]));
+        }
+    }
+
+    static bool isAligned(const uint8_t *ptr, int size) {
+        return ((uintptr_t)ptr & (size - 1)) == 0;
+    }
+};
+
+template <SampleFormat To>
+struct FormatKernel<FORMAT_S24_PACKED, To> {
+    static void convert(const uint8_t *in, uint8_t *out, size_t samples) {
+        typedef SampleFormatTraits<FORMAT_S24_PACKED> in_format;
+        typedef SampleFormatTraits<To> out_format;
+        int32_t values[4];
+        size_t j = 0;
+        for (; j+4<=samples; j+=4){
+            in_format::toInt32x4(in + j*in_format::size, values);
+            out_format::fromInt32(values[0], out + j*out_format::size);
+            out_format::fromInt32(values[1], out + (j+1)*out_format::size);
+            out_format::fromInt32(values[2], out + (j+2)*out_format::size);
+            out_format::fromInt32(values[3], out + (j+3)*out_format::size);
+        }
+        FormatKernelBytes<FORMAT_S24_PACKED, To>::convert(in + j*in_format::size, out + j*out_format::size, samples - j);
+    }
+};
+
+template <SampleFormat From>
+struct FormatKernel<From, FORMAT_S24_PACKED> : public FormatKernelBytes<From, FORMAT_S24_PACKED> {};
+
+/// no conversion necessary
+template <SampleFormat F>
+struct FormatKernel<F, F> {
+    static void convert(const uint8_t *in, uint8_t *out, size_t samples) {
+        if (in!=out){
+            memmove(out, in, samples * SampleFormatTraits<F>::size);
+        }
+    }
+};
+
+template <>
+struct FormatKernel<FORMAT_S24_PACKED, FORMAT_S24_PACKED> {
+    static void convert(const uint8_t *in, uint8_t *out, size_t samples) {
+        if (in!=out){
+            memmove(out, in, samples * 3);
+        }
+    }
+};
+
+/**
+ * @brief Provides the FormatKernel for a pair of formats which are only known at runtime
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FormatKernels {
+    public:
+        /// Provides the size of a sample in bytes
+        static int sampleSize(SampleFormat format) {
+            switch(format){
+                case FORMAT_U8:
+                case FORMAT_S8:
+                    return 1;
+                case FORMAT_S16:
+                    return 2;
+                case FORMAT_S24_PACKED:
+                    return 3;
+                default:
+                    return 4;
+            }
+        }
+
+        /// Provides the conversion function from -> to
+        static FormatKernelFunction get(SampleFormat from, SampleFormat to) {
+            switch(from){
+                case FORMAT_U8: return get<FORMAT_U8>(to);
+                case FORMAT_S8: return get<FORMAT_S8>(to);
+                case FORMAT_S16: return get<FORMAT_S16>(to);
+                case FORMAT_S24_PACKED: return get<FORMAT_S24_PACKED>(to);
+                case FORMAT_S24_IN_32: return get<FORMAT_S24_IN_32>(to);
+                case FORMAT_S32: return get<FORMAT_S32>(to);
+                case FORMAT_FLOAT: return get<FORMAT_FLOAT>(to);
+            }
+            return nullptr;
+        }
+
+        /// Converts the samples from -> to
+        static void convert(SampleFormat from, SampleFormat to, const uint8_t *in, uint8_t *out, size_t samples) {
+            get(from, to)(in, out, samples);
+        }
+
+    protected:
+        template <SampleFormat From>
+        static FormatKernelFunction get(SampleFormat to) {
+            switch(to){
+                case FORMAT_U8: return FormatKernel<From, FORMAT_U8>::convert;
+                case FORMAT_S8: return FormatKernel<From, FORMAT_S8>::convert;
+                case FORMAT_S16: return FormatKernel<From, FORMAT_S16>::convert;
+                case FORMAT_S24_PACKED: return FormatKernel<From, FORMAT_S24_PACKED>::convert;
+                case FORMAT_S24_IN_32: return FormatKernel<From, FORMAT_S24_IN_32>::convert;
+                case FORMAT_S32: return FormatKernel<From, FORMAT_S32>::convert;
+                case FORMAT_FLOAT: return FormatKernel<From, FORMAT_FLOAT>::convert;
+            }
+            return nullptr;
+        }
+};
+
+/**
+ * @brief Stream which converts the sample format (e.g. from 24 bit packed to 16 bit). Data which is written is
+ * converted and passed on to the output. If the output does not accept all data, the rest is kept and written
+ * first with the next write, so nothing is lost. If an input stream is defined the data can be read in the
+ * converted format. Incomplete samples are kept until they can be completed.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FormatConverter : public AudioStream {
+    public:
+        /// Converts the data which is written and writes it to the output
+        FormatConverter(Print &out, SampleFormat from, SampleFormat to, int bufferSize=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
+            this->out = &out;
+            setup(from, to, bufferSize, allocator);
+        }
+
+        /// Converts the data which is read from the input
+        FormatConverter(Stream &in, SampleFormat from, SampleFormat to, int bufferSize=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
+            this->in = &in;
+            setup(from, to, bufferSize, allocator);
+        }
+
+        ~FormatConverter(){
+            allocator->removeArray(buffer, buffer_size);
+        }
+
+        /// Converts the data and writes it to the output: returns the number of consumed input bytes
+        virtual size_t write(const uint8_t *data, size_t len) {
+            if (out==nullptr || buffer==nullptr || !writePending()) return 0;
+            size_t result = 0;
+            // complete the pending sample
+            while (partial_len > 0 && result < len){
+                partial[partial_len++] = data[result++];
+                if (partial_len == in_size){
+                    kernel(partial, buffer, 1);
+                    partial_len = 0;
+                    pending_start = 0;
+                    pending_end = out_size;
+                    if (!writePending()) return result;
+                }
+            }
+            size_t max_samples = buffer_size / out_size;
+            while (len - result >= (size_t) in_size){
+                size_t samples = MIN((len - result) / in_size, max_samples);
+                kernel(data + result, buffer, samples);
+                result += samples * in_size;
+                pending_start = 0;
+                pending_end = samples * out_size;
+                if (!writePending()) return result;
+            }
+            // keep the incomplete sample
+            while (result < len){
+                partial[partial_len++] = data[result++];
+            }
+            return result;
+        }
+
+        /// Converts the data which is read from the input stream
+        virtual size_t readBytes(uint8_t *data, size_t len) {
+            if (in==nullptr || buffer==nullptr) return 0;
+            size_t result = 0;
+            size_t max_samples = buffer_size / in_size;
+            while (len - result >= (size_t) out_size){
+                size_t samples = MIN((len - result) / out_size, max_samples);
+                size_t bytes = partial_len + in->readBytes(buffer + partial_len, samples * in_size - partial_len);
+                size_t converted = bytes / in_size;
+                kernel(buffer, data + result, converted);
+                result += converted * out_size;
+                // keep the incomplete sample
+                partial_len = bytes - converted * in_size;
+                if (partial_len > 0){
+                    memmove(buffer, buffer + converted * in_size, partial_len);
+                }
+                if (converted < samples) break;
+            }
+            return result;
+        }
+
+        /// Number of converted bytes which can be read
+        virtual int available() {
+            return in==nullptr ? 0 : (in->available() + partial_len) / in_size * out_size;
+        }
+
+        /// Number of input bytes which can be written
+        virtual int availableForWrite() {
+            return pending_end > pending_start ? 0 : buffer_size / out_size * in_size;
+        }
+
+        /// Writes the pending converted data
+        virtual void flush() {
+            writePending();
+        }
+
+        /// Size of an input sample in bytes
+        int inputSampleSize() {
+            return in_size;
+        }
+
+        /// Size of an output sample in bytes
+        int outputSampleSize() {
+            return out_size;
+        }
+
+    protected:
+        Print *out = nullptr;
+        Stream *in = nullptr;
+        FormatKernelFunction kernel;
+        Allocator *allocator;
+        uint8_t *buffer = nullptr;
+        int buffer_size = 0;
+        int in_size;
+        int out_size;
+        uint8_t partial[4];
+        int partial_len = 0;
+        size_t pending_start = 0;
+        size_t pending_end = 0;
+
+        void setup(SampleFormat from, SampleFormat to, int bufferSize, Allocator &allocator){
+            this->allocator = &allocator;
+            kernel = FormatKernels::get(from, to);
+            in_size = FormatKernels::sampleSize(from);
+            out_size = FormatKernels::sampleSize(to);
+            // we need space for at least one input and output sample
+            buffer_size = max(bufferSize, 4);
+            buffer = allocator.createArray<uint8_t>(buffer_size);
+            if (buffer==nullptr){
+                LOGE("FormatConverter could not allocate %d bytes", buffer_size);
+                buffer_size = 0;
+            }
+        }
+
+        /// writes the converted data: returns true if everything was written
+        bool writePending() {
+            while (pending_end > pending_start){
+                size_t written = out->write(buffer + pending_start, pending_end - pending_start);
+                if (written==0) return false;
+                pending_start += written;
+            }
+            return true;
+        }
+};
+
+}
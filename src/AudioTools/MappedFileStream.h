@@ -0,0 +1,148 @@
+#pragma once
+/**
+ * @brief Memory mapped file which can be used as audio source on the desktop
+ * 
+ */
+
+#if defined(__linux__) || defined(__APPLE__)
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/Buffers.h"
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Read only Stream for a file which is mapped into the memory with mmap: so the whole file can be 
+ * accessed with data() and size() w/o copying it. E.g. you can pass it directly to a decoder with
+ * decoder.write(file.data(), file.size()) or copy it with StreamCopy::begin(out, file.data(), file.size()). 
+ * We advise the kernel that we read sequentially so that it can read ahead.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MappedFileStream : public AudioStream {
+    public:
+        MappedFileStream() = default;
+
+        MappedFileStream(const char* path) {
+            begin(path);
+        }
+
+        ~MappedFileStream() {
+            end();
+        }
+
+        /// Maps the indicated file into the memory
+        bool begin(const char* path) {
+            LOGD("MappedFileStream: %s", path);
+            end();
+            int fd = open(path, O_RDONLY);
+            if (fd<0){
+                LOGE("Could not open %s", path);
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info)!=0 || info.st_size==0){
+                LOGE("Could not determine the size of %s", path);
+                close(fd);
+                return false;
+            }
+            void *area = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            // the mapping stays valid after the file has been closed
+            close(fd);
+            if (area==MAP_FAILED){
+                LOGE("Could not map %s", path);
+                return false;
+            }
+            madvise(area, info.st_size, MADV_SEQUENTIAL);
+            file_data = (const uint8_t*) area;
+            file_size = info.st_size;
+            read_pos = 0;
+            return true;
+        }
+
+        /// Restarts the reading at the beginning of the file
+        void begin() {
+            read_pos = 0;
+        }
+
+        /// Releases the mapping
+        void end() {
+            if (file_data!=nullptr){
+                munmap((void*)file_data, file_size);
+                file_data = nullptr;
+                file_size = 0;
+                read_pos = 0;
+            }
+        }
+
+        /// Provides the content of the file
+        const uint8_t* data() {
+            return file_data;
+        }
+
+        /// Provides the size of the file in bytes
+        size_t size() {
+            return file_size;
+        }
+
+        /// Provides the number of unread bytes: limited to INT_MAX for big files
+        virtual int available() {
+            size_t result = file_size - read_pos;
+            return result > (size_t) INT_MAX ? INT_MAX : (int) result;
+        }
+
+        virtual int read() {
+            int result = peek();
+            if (result>=0){
+                read_pos++;
+            }
+            return result;
+        }
+
+        virtual int peek() {
+            return available()>0 ? file_data[read_pos] : -1;
+        }
+
+        size_t readBytes(uint8_t *data, size_t length) {
+            size_t result = MIN(length, (size_t) available());
+            if (result>0){
+                memcpy(data, file_data + read_pos, result);
+                read_pos += result;
+            }
+            return result;
+        }
+
+        size_t readBytes(char *data, size_t length) {
+            return readBytes((uint8_t*)data, length);
+        }
+
+        // not supported
+        virtual size_t write(const uint8_t *data, size_t len) {
+            return 0;
+        }
+
+        // not supported
+        virtual int availableForWrite() {
+            return 0;
+        }
+
+        operator bool() {
+            return file_data!=nullptr;
+        }
+
+    protected:
+        const uint8_t *file_data = nullptr;
+        size_t file_size = 0;
+        size_t read_pos = 0;
+};
+
+} // namespace
+
+#endif
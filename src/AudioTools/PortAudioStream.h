@@ -30,10 +30,11 @@ class PortAudioConfig : public AudioBaseInfo {
 };
 
 /**
- * @brief Arduino Audio Stream using PortAudio
+ * @brief Arduino Audio Stream using PortAudio. If the host supports it, the output is collected in a 
+ * MirroredRingBuffer and Pa_WriteStream() takes the full blocks directly from the ring.
  * 
  */
-class PortAudioStream : public BufferedStream,  public AudioBaseInfoDependent {
+class PortAudioStream : public BufferedStream {
     public:
         PortAudioStream(int buffer_size=DEFAULT_BUFFER_SIZE):BufferedStream(buffer_size) {
             LOGD(__FUNCTION__);
@@ -43,6 +44,9 @@ class PortAudioStream : public BufferedStream,  public AudioBaseInfoDependent {
         ~PortAudioStream(){
             LOGD(__FUNCTION__);
             Pa_Terminate();
+#ifdef USE_MIRRORED_BUFFER
+            delete ring;
+#endif
         }
 
         PortAudioConfig defaultConfig() {
@@ -69,6 +73,12 @@ class PortAudioStream : public BufferedStream,  public AudioBaseInfoDependent {
         void begin(PortAudioConfig info) {
             LOGD(__FUNCTION__);
             this->info = info;
+            setFrameSize(info.channels * info.bits_per_sample / 8);
+#ifdef USE_MIRRORED_BUFFER
+            if (info.is_output){
+                setupRing();
+            }
+#endif
 
             if (info.channels>0 && info.sample_rate && info.bits_per_sample>0){
                 LOGD("Pa_Initialize");
@@ -121,12 +131,70 @@ class PortAudioStream : public BufferedStream,  public AudioBaseInfoDependent {
             return err == paNoError;
         }
 
+#ifdef USE_MIRRORED_BUFFER
+        /// Collects the data in the ring buffer and writes all full blocks from there
+        virtual size_t write(const uint8_t* data, size_t len) {
+            if (ring==nullptr) return BufferedStream::write(data, len);
+            size_t result = 0;
+            while (result < len){
+                result += ring->writeArray(data + result, len - result);
+                if (!writeRing(block_bytes)) break;
+            }
+            return result;
+        }
+
+        /// Writes all full frames of the ring buffer
+        virtual void flush() {
+            if (ring==nullptr){
+                BufferedStream::flush();
+                return;
+            }
+            writeRing(frameBytes());
+        }
+#endif
+
     protected:
         PaStream *stream = nullptr;
         PaError err = paNoError;
         PortAudioConfig info;
         bool stream_started = false;
         int buffer_size;
+#ifdef USE_MIRRORED_BUFFER
+        MirroredRingBuffer<uint8_t> *ring = nullptr;
+        int block_bytes = 0;
+
+        int frameBytes() {
+            return info.channels * info.bits_per_sample / 8;
+        }
+
+        /// the ring holds 2 blocks, so that we can write while a block is ready: falls back to the 
+        /// BufferedStream if the memory could not be mapped
+        void setupRing() {
+            delete ring;
+            ring = nullptr;
+            int frame_bytes = frameBytes();
+            if (frame_bytes<=0) return;
+            block_bytes = max(buffer_size - (buffer_size % frame_bytes), frame_bytes);
+            ring = new MirroredRingBuffer<uint8_t>(2 * block_bytes);
+            if (ring->size()==0){
+                delete ring;
+                ring = nullptr;
+            }
+        }
+
+        /// passes the full frames from the ring to Pa_WriteStream() as long as we have at least minBytes
+        bool writeRing(int minBytes) {
+            int frame_bytes = frameBytes();
+            while (ring->available() >= minBytes && ring->available() >= frame_bytes){
+                BufferSpan<uint8_t> span = ring->readPeek();
+                int len = MIN(span.size, block_bytes);
+                len -= len % frame_bytes;
+                if (writeExt(span.data, len) == 0) return false;
+                ring->readConsume(len);
+            }
+            return true;
+        }
+#endif
 
         virtual size_t writeExt(const uint8_t* data, size_t len) {  
             LOGD("writeExt: %zu", len);
@@ -165,7 +233,7 @@ class PortAudioStream : public BufferedStream,  public AudioBaseInfoDependent {
             } else {
                 LOGW("stream is null")
             }
-            return len;            
+            return result;            
         }
 
         PaSampleFormat getFormat(int bitLength){
@@ -0,0 +1,447 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/Allocator.h"
+
+namespace audio_tools {
+
+/// Quality of the resampling: a higher quality uses a longer filter and needs more CPU and memory
+enum ResampleQuality {RESAMPLE_LOW, RESAMPLE_MEDIUM, RESAMPLE_HIGH};
+
+/**
+ * @brief Number types which are used by the Resampler: int16_t is processed with Q15 coefficients and a
+ * 32 bit accumulator, float is processed with float coefficients.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+struct ResampleTraits;
+
+template <>
+struct ResampleTraits<int16_t> {
+    typedef int16_t coefficient_t;
+    typedef int32_t accumulator_t;
+
+    static coefficient_t toCoefficient(double value) {
+        double result = value * 32768.0;
+        result = result < 0 ? result - 0.5 : result + 0.5;
+        return result > 32767.0 ? 32767 : (result < -32768.0 ? -32768 : (int16_t) result);
+    }
+
+    static inline int16_t toSample(int32_t value) {
+        int32_t result = (value + 16384) >> 15;
+        return result > 32767 ? 32767 : (result < -32768 ? -32768 : result);
+    }
+
+    /// weight is a Q16 value
+    static inline int32_t interpolate(int32_t a, int32_t b, uint32_t weight) {
+        return a + (int32_t)(((int64_t)b - a) * weight >> 16);
+    }
+};
+
+template <>
+struct ResampleTraits<float> {
+    typedef float coefficient_t;
+    typedef float accumulator_t;
+
+    static coefficient_t toCoefficient(double value) {
+        return value;
+    }
+
+    static inline float toSample(float value) {
+        return value;
+    }
+
+    /// weight is a Q16 value
+    static inline float interpolate(float a, float b, uint32_t weight) {
+        return a + (b - a) * (weight * (1.0f / 65536.0f));
+    }
+};
+
+/**
+ * @brief Sample rate conversion with an arbitrary ratio: we use a polyphase FIR filter (Kaiser windowed sinc)
+ * and select the phase with a 32.32 fixed point position, so there is no drift. With the medium and high quality
+ * the result is interpolated between the 2 neighboring phases. The input is kept in a history buffer, so that
+ * the data can be provided in blocks of any size. Supported sample types are int16_t and float.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class Resampler {
+    public:
+        typedef typename ResampleTraits<T>::coefficient_t coefficient_t;
+        typedef typename ResampleTraits<T>::accumulator_t accumulator_t;
+
+        Resampler(Allocator &allocator=defaultAllocator()){
+            this->allocator = &allocator;
+        }
+
+        ~Resampler(){
+            end();
+        }
+
+        /// Defines the number of channels and the sample rates
+        bool begin(int channels, int fromRate, int toRate, ResampleQuality quality=RESAMPLE_MEDIUM){
+            end();
+            if (channels<=0 || fromRate<=0 || toRate<=0){
+                LOGE("Resampler: invalid parameters");
+                return false;
+            }
+            this->channels = channels;
+            setupQuality(quality);
+            step = ((uint64_t)fromRate << 32) / toRate;
+            coefficients = allocator->createArray<coefficient_t>(coefficientCount());
+            history_capacity = taps + RESAMPLE_BLOCK_FRAMES;
+            history = allocator->createArray<T>(history_capacity * channels);
+            if (coefficients==nullptr || history==nullptr){
+                end();
+                return false;
+            }
+            setupCoefficients(fromRate, toRate);
+            reset();
+            return true;
+        }
+
+        /// Releases the memory
+        void end() {
+            allocator->removeArray(coefficients, coefficientCount());
+            allocator->removeArray(history, history_capacity * channels);
+            coefficients = nullptr;
+            history = nullptr;
+            history_capacity = 0;
+        }
+
+        /// Clears the history
+        void reset() {
+            // the first output sample is aligned to the first input frame
+            history_frames = taps/2 - 1;
+            memset(history, 0, history_frames * channels * sizeof(T));
+            position = 0;
+        }
+
+        /// Resamples up to inFrames interleaved input frames into up to outFrames output frames: returns the
+        /// number of output frames and provides the number of consumed input frames in usedFrames
+        size_t resample(const T *in, size_t inFrames, T *out, size_t outFrames, size_t &usedFrames) {
+            return resample((const uint8_t*) in, inFrames, out, outFrames, usedFrames);
+        }
+
+        /// Same as above for input data which might not be aligned: it is only copied with memcpy
+        size_t resample(const uint8_t *in, size_t inFrames, T *out, size_t outFrames, size_t &usedFrames) {
+            usedFrames = 0;
+            if (history==nullptr) return 0;
+            size_t result = 0;
+            while (true) {
+                while (result < outFrames && index() + taps <= history_frames){
+                    resampleFrame(out + result * channels);
+                    position += step;
+                    result++;
+                }
+                if (result == outFrames || usedFrames == inFrames) break;
+                compact();
+                // drop the input frames which are skipped completely
+                size_t skip = MIN(index(), inFrames - usedFrames);
+                if (skip > 0){
+                    usedFrames += skip;
+                    position -= (uint64_t)skip << 32;
+                    continue;
+                }
+                size_t frames = MIN(inFrames - usedFrames, history_capacity - history_frames);
+                memcpy(history + history_frames * channels, in + usedFrames * channels * sizeof(T), frames * channels * sizeof(T));
+                history_frames += frames;
+                usedFrames += frames;
+            }
+            return result;
+        }
+
+        /// Number of channels
+        int channelCount() {
+            return channels;
+        }
+
+        /// Length of the filter
+        int tapCount() {
+            return taps;
+        }
+
+    protected:
+        Allocator *allocator;
+        coefficient_t *coefficients = nullptr;
+        T *history = nullptr;
+        size_t history_capacity = 0;
+        size_t history_frames = 0;
+        uint64_t position = 0;
+        uint64_t step = 0;
+        int channels = 0;
+        int taps = 0;
+        int phase_bits = 0;
+        bool interpolated = false;
+        float beta = 0;
+        float bandwidth = 0;
+
+        void setupQuality(ResampleQuality quality) {
+            switch(quality){
+                case RESAMPLE_LOW:
+                    taps = 8; phase_bits = 5; interpolated = false; beta = 5.0; bandwidth = 0.80;
+                    break;
+                case RESAMPLE_MEDIUM:
+                    taps = 16; phase_bits = 6; interpolated = true; beta = 7.0; bandwidth = 0.85;
+                    break;
+                case RESAMPLE_HIGH:
+                    taps = 32; phase_bits = 8; interpolated = true; beta = 9.0; bandwidth = 0.90;
+                    break;
+            }
+        }
+
+        /// we provide one additional phase for the interpolation
+        int coefficientCount() {
+            return ((1 << phase_bits) + 1) * taps;
+        }
+
+        /// index of the first history frame which is used for the actual output frame
+        size_t index() {
+            return position >> 32;
+        }
+
+        void resampleFrame(T *out) {
+            uint32_t fraction = position & 0xFFFFFFFF;
+            uint32_t phase = fraction >> (32 - phase_bits);
+            uint32_t weight = (fraction >> (16 - phase_bits)) & 0xFFFF;
+            const coefficient_t *c0 = coefficients + phase * taps;
+            const T *data = history + index() * channels;
+            for (int ch=0; ch<channels; ch++){
+                accumulator_t value = dot(data + ch, c0);
+                if (interpolated){
+                    value = ResampleTraits<T>::interpolate(value, dot(data + ch, c0 + taps), weight);
+                }
+                out[ch] = ResampleTraits<T>::toSample(value);
+            }
+        }
+
+        inline accumulator_t dot(const T *data, const coefficient_t *c) {
+            accumulator_t result = 0;
+            for (int j=0; j<taps; j++){
+                result += (accumulator_t)data[j * channels] * c[j];
+            }
+            return result;
+        }
+
+        /// removes the frames which are not needed any more
+        void compact() {
+            // when we downsample with a big ratio we can skip more frames than we have: the rest stays in position
+            size_t start = MIN(index(), history_frames);
+            if (start > 0){
+                history_frames -= start;
+                memmove(history, history + start * channels, history_frames * channels * sizeof(T));
+                position -= (uint64_t)start << 32;
+            }
+        }
+
+        /// Kaiser windowed sinc: the cutoff is reduced when we downsample
+        void setupCoefficients(int fromRate, int toRate) {
+            int phases = 1 << phase_bits;
+            double cutoff = bandwidth * (toRate < fromRate ? (double)toRate / fromRate : 1.0);
+            double half = taps / 2.0;
+            for (int p=0; p<=phases; p++){
+                double mu = (double) p / phases;
+                double sum = 0;
+                for (int j=0; j<taps; j++){
+                    sum += coefficient(j - (taps/2 - 1) - mu, cutoff, half);
+                }
+                // unity gain for all phases
+                for (int j=0; j<taps; j++){
+                    coefficients[p * taps + j] = ResampleTraits<T>::toCoefficient(coefficient(j - (taps/2 - 1) - mu, cutoff, half) / sum);
+                }
+            }
+        }
+
+        /// filter value at the distance t (in input frames)
+        double coefficient(double t, double cutoff, double half) {
+            double x = t / half;
+            double window = x <= -1.0 || x >= 1.0 ? 0.0 : besselI0(beta * sqrt(1.0 - x * x)) / besselI0(beta);
+            return cutoff * sinc(cutoff * t) * window;
+        }
+
+        static double sinc(double x) {
+            return x == 0.0 ? 1.0 : sin(PI * x) / (PI * x);
+        }
+
+        static double besselI0(double x) {
+            double result = 1.0;
+            double term = 1.0;
+            for (int k=1; k<50 && term > 1e-12 * result; k++){
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                result += term;
+            }
+            return result;
+        }
+};
+
+/**
+ * @brief Stream which converts the sample rate of the data which is written to it and writes the result to the
+ * output. The input format is defined with setAudioInfo(), so the stream can be notified by a decoder. If the
+ * output does not accept all data, the rest is kept and written first with the next write. Incomplete frames
+ * are kept until they can be completed.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class ResampleStreamT : public AudioStream {
+    public:
+        ResampleStreamT(Print &out, int toRate, ResampleQuality quality=RESAMPLE_MEDIUM, int bufferSize=DEFAULT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()) : resampler(allocator) {
+            this->out = &out;
+            this->to_rate = toRate;
+            this->quality = quality;
+            this->buffer_size = bufferSize;
+            this->allocator = &allocator;
+        }
+
+        ~ResampleStreamT(){
+            end();
+        }
+
+        /// Defines the format of the input data: the resampling is only restarted if the format has changed
+        virtual void setAudioInfo(AudioBaseInfo info) {
+            bool changed = !(info == audio_info);
+            AudioStream::setAudioInfo(info);
+            if (changed || buffer==nullptr){
+                begin();
+            }
+            if (notify!=nullptr){
+                notify->setAudioInfo(audioInfo());
+            }
+        }
+
+        /// Provides the format of the resampled data
+        virtual AudioBaseInfo audioInfo() {
+            AudioBaseInfo result = audio_info;
+            result.sample_rate = to_rate;
+            return result;
+        }
+
+        /// The output is informed about the resampled format
+        void setNotifyAudioChange(AudioBaseInfoDependent &bi) {
+            notify = &bi;
+        }
+
+        /// Starts the processing with the actual audio info
+        bool begin() {
+            end();
+            if (audio_info.bits_per_sample != sizeof(T) * 8){
+                LOGE("ResampleStream: bits_per_sample must be %d", (int) sizeof(T) * 8);
+                return false;
+            }
+            if (!resampler.begin(audio_info.channels, audio_info.sample_rate, to_rate, quality)){
+                return false;
+            }
+            frame_size = audio_info.channels * sizeof(T);
+            buffer_frames = max(buffer_size / frame_size, 1);
+            buffer_samples = buffer_frames * audio_info.channels;
+            buffer = allocator->createArray<T>(buffer_samples);
+            partial = allocator->createArray<uint8_t>(frame_size);
+            if (buffer==nullptr || partial==nullptr){
+                end();
+                return false;
+            }
+            return true;
+        }
+
+        /// Releases the memory
+        void end() {
+            resampler.end();
+            allocator->removeArray(buffer, buffer_samples);
+            allocator->removeArray(partial, frame_size);
+            buffer = nullptr;
+            partial = nullptr;
+            partial_len = 0;
+            pending_start = 0;
+            pending_end = 0;
+        }
+
+        /// Resamples the data and writes it to the output: returns the number of consumed input bytes
+        virtual size_t write(const uint8_t *data, size_t len) {
+            if (buffer==nullptr || !writePending()) return 0;
+            size_t result = 0;
+            // complete the pending frame
+            while (partial_len > 0 && partial_len < frame_size && result < len){
+                partial[partial_len++] = data[result++];
+            }
+            if (partial_len == frame_size){
+                if (process(partial, 1) == 0) return result;
+                partial_len = 0;
+            }
+            while (len - result >= (size_t) frame_size){
+                size_t frames = (len - result) / frame_size;
+                size_t used = process(data + result, frames);
+                result += used * frame_size;
+                if (used < frames) return result;
+            }
+            // keep the incomplete frame
+            while (result < len){
+                partial[partial_len++] = data[result++];
+            }
+            return result;
+        }
+
+        /// not supported
+        virtual size_t readBytes(uint8_t *data, size_t len) {
+            return 0;
+        }
+
+        /// Number of input bytes which can be written
+        virtual int availableForWrite() {
+            return pending_end > pending_start || buffer==nullptr ? 0 : buffer_frames * frame_size;
+        }
+
+        /// Writes the pending resampled data
+        virtual void flush() {
+            writePending();
+        }
+
+    protected:
+        Resampler<T> resampler;
+        Print *out = nullptr;
+        AudioBaseInfoDependent *notify = nullptr;
+        Allocator *allocator;
+        ResampleQuality quality;
+        int to_rate;
+        int buffer_size;
+        T *buffer = nullptr;
+        int buffer_frames = 0;
+        int buffer_samples = 0;
+        int frame_size = 0;
+        uint8_t *partial = nullptr;
+        int partial_len = 0;
+        size_t pending_start = 0;
+        size_t pending_end = 0;
+
+        /// resamples the frames until the output does not accept any more data: returns the consumed frames
+        size_t process(const uint8_t *data, size_t frames) {
+            size_t result = 0;
+            while (true){
+                size_t used;
+                size_t produced = resampler.resample(data + result * frame_size, frames - result, buffer, buffer_frames, used);
+                result += used;
+                pending_start = 0;
+                pending_end = produced * frame_size;
+                if (!writePending() || (result == frames && produced < (size_t) buffer_frames)) break;
+            }
+            return result;
+        }
+
+        /// writes the resampled data: returns true if everything was written
+        bool writePending() {
+            while (pending_end > pending_start){
+                size_t written = out->write((uint8_t*)buffer + pending_start, pending_end - pending_start);
+                if (written==0) return false;
+                pending_start += written;
+            }
+            return true;
+        }
+};
+
+/// Resampling of 16 bit data
+typedef ResampleStreamT<int16_t> ResampleStream;
+
+}
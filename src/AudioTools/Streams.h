@@ -3,23 +3,31 @@
 #include "AudioConfig.h"
 #include "AudioTypes.h"
 #include "Buffers.h"
+#include "Vector.h"
 #include "AudioI2S.h"
 
 namespace audio_tools {
 
 /**
- * @brief A simple Stream implementation which is backed by allocated memory
+ * @brief A simple Stream implementation which is backed by allocated memory. In growable mode additional 
+ * chunks of buffer_size bytes are allocated when needed, so that we can record data of any length 
+ * without copying the already recorded data. 
  * @author Phil Schatzmann
  * @copyright GPLv3
  * 
  */
-class MemoryStream : public Stream {
+class MemoryStream : public AudioStream {
     public: 
-        MemoryStream(int buffer_size = 512){
+        MemoryStream(int buffer_size = 512, Allocator &allocator=defaultAllocator(), bool growable=false){
 	 		LOGD("MemoryStream: %d", buffer_size);
             this->buffer_size = buffer_size;
-            this->buffer = new uint8_t[buffer_size];
+            this->allocator = &allocator;
+            this->buffer = allocator.createArray<uint8_t>(buffer_size);
+            if (this->buffer==nullptr){
+                this->buffer_size = 0;
+            }
             this->owns_buffer = true;
+            this->is_growable = growable;
         }
 
         MemoryStream(const uint8_t *buffer, int buffer_size){
@@ -32,34 +40,42 @@ class MemoryStream : public Stream {
 
         ~MemoryStream(){
 	 		LOGD(__FUNCTION__);
+            // the external buffer is not managed by an allocator
+            if (allocator==nullptr) return;
             if (owns_buffer)
-                delete[] buffer;
+                allocator->removeArray(buffer, buffer_size);
+            for (int j=0;j<chunk_count;j++){
+                allocator->removeArray(chunks[j], buffer_size);
+            }
+            allocator->removeArray(chunks, chunks_size);
         }
 
         // resets the read pointer
         void begin() {
 	 		LOGD(__FUNCTION__);
-            write_pos = buffer_size;
+            // in growable mode we keep the recorded data
+            if (!is_growable){
+                write_pos = buffer_size;
+            }
             read_pos = 0;
         }
 
         virtual size_t write(uint8_t byte) {
-            int result = 0;
-            if (write_pos<buffer_size){
-                result = 1;
-                buffer[write_pos] = byte;
-                write_pos++;
-            }
-            return result;
+            return write(&byte, 1);
         }
 
-        virtual size_t write(const uint8_t *buffer, size_t size){
+        /// writes the data with memcpy: in growable mode we allocate additional chunks if necessary
+        virtual size_t write(const uint8_t *data, size_t size){
             size_t result = 0;
-            for (size_t j=0;j<size;j++){
-                if(!write(buffer[j])){
+            while (result < size){
+                if (write_pos >= capacity() && !addChunk()){
                     break;
                 }
-                result = j;
+                int offset = write_pos % buffer_size;
+                int len = MIN((int)(size - result), buffer_size - offset);
+                memcpy(chunk(write_pos / buffer_size) + offset, data + result, len);
+                write_pos += len;
+                result += len;
             }
             return result;
         }
@@ -68,6 +84,12 @@ class MemoryStream : public Stream {
             return write_pos - read_pos;
         }
 
+        /// Provides the free space: in growable mode we can add at least one more chunk
+        virtual int availableForWrite() {
+            int result = capacity() - write_pos;
+            return is_growable ? max(result, buffer_size) : result;
+        }
+
         virtual int read() {
             int result = peek();
             if (result>=0){
@@ -76,22 +98,27 @@ class MemoryStream : public Stream {
             return result;
         }
 
-        size_t readBytes(char *buffer, size_t length){
-            size_t count = 0;
-            while (count < length) {
-                int c = read();
-                if (c < 0) break;
-                *buffer++ = (char)c;
-                count++;
+        /// reads the data with memcpy
+        size_t readBytes(uint8_t *data, size_t length){
+            size_t result = 0;
+            while (result < length && available() > 0){
+                int offset = read_pos % buffer_size;
+                int len = MIN(MIN((int)(length - result), buffer_size - offset), available());
+                memcpy(data + result, chunk(read_pos / buffer_size) + offset, len);
+                read_pos += len;
+                result += len;
             }
-            return count;
+            return result;
         }
 
+        size_t readBytes(char *buffer, size_t length){
+            return readBytes((uint8_t*)buffer, length);
+        }
 
         virtual int peek() {
             int result = -1;
             if (available()>0){
-                result = buffer[read_pos];
+                result = chunk(read_pos / buffer_size)[read_pos % buffer_size];
             }
             return result;
         }
@@ -105,9 +132,16 @@ class MemoryStream : public Stream {
             if (reset){
                 // we clear the buffer data
                 memset(buffer,0,buffer_size);
+                for (int j=0;j<chunk_count;j++){
+                    memset(chunks[j], 0, buffer_size);
+                }
             }
         }
 
+        /// Provides the number of bytes that have been written
+        size_t size() {
+            return write_pos;
+        }
 
         operator bool() {
             return available()>0;
@@ -119,12 +153,53 @@ class MemoryStream : public Stream {
         int buffer_size = 0;
         uint8_t *buffer = nullptr;
         bool owns_buffer=false;
+        bool is_growable = false;
+        Allocator *allocator = nullptr;
+        // additional chunks in growable mode
+        uint8_t **chunks = nullptr;
+        int chunk_count = 0;
+        int chunks_size = 0;
+
+        int capacity() {
+            return buffer_size * (chunk_count + 1);
+        }
+
+        /// provides the chunk with the indicated index: the first chunk is the buffer
+        uint8_t *chunk(int idx) {
+            return idx == 0 ? buffer : chunks[idx - 1];
+        }
+
+        /// allocates an additional chunk in growable mode
+        bool addChunk() {
+            if (!is_growable || buffer_size <= 0){
+                return false;
+            }
+            // grow the chunk table by doubling its size
+            if (chunk_count == chunks_size){
+                int new_size = chunks_size == 0 ? 8 : chunks_size * 2;
+                uint8_t **new_chunks = allocator->createArray<uint8_t*>(new_size);
+                if (new_chunks == nullptr){
+                    return false;
+                }
+                if (chunks != nullptr){
+                    memcpy(new_chunks, chunks, chunk_count * sizeof(uint8_t*));
+                    allocator->removeArray(chunks, chunks_size);
+                }
+                chunks = new_chunks;
+                chunks_size = new_size;
+            }
+            uint8_t *new_chunk = allocator->createArray<uint8_t>(buffer_size);
+            if (new_chunk == nullptr){
+                return false;
+            }
+            chunks[chunk_count++] = new_chunk;
+            return true;
+        }
 };
 
 /**
  * @brief Source for reading generated tones. Please note 
  * - that the output is for one channel only! 
- * - we do not support reading of individual characters!
  * - we do not support any write operations
  * @param generator 
  * @author Phil Schatzmann
@@ -132,44 +207,31 @@ class MemoryStream : public Stream {
  */
 
 template <class T>
-class GeneratedSoundStream : public Stream {
+class GeneratedSoundStream : public AudioStream {
     public:
         GeneratedSoundStream(SoundGenerator<T> &generator){
 	 		LOGD(__FUNCTION__);
             this->generator_ptr = &generator;
         }
         
-        /// unsupported operations
-        virtual size_t write(uint8_t) {
-            return not_supported();
-        };
         /// unsupported operations
         virtual int availableForWrite() {       
-            return not_supported();
+            return 0;
         }
 
         /// unsupported operations
         virtual size_t write(const uint8_t *buffer, size_t size) { 
-            return not_supported();
+            return 0;
         }
 
-        /// unsupported operations
-        virtual int read() {
-            return -1;
-        }        
-        /// unsupported operations
-        virtual int peek() {
-            return -1;
-        }
-        /// This is unbounded so we just return the buffer size
+        /// This is unbounded so we just return the buffer size as long as the generator is active
         virtual int available() {
-            return DEFAULT_BUFFER_SIZE;
+            return generator_ptr->isActive() ? DEFAULT_BUFFER_SIZE : 0;
         }
 
         /// privide the data as byte stream
         size_t readBytes( char *buffer, size_t length) {
-            LOGD("GeneratedSoundStream::readBytes: %zu", length);
-            return generator_ptr->readBytes((uint8_t*)buffer, length);
+            return readBytes((uint8_t*)buffer, length);
         }
 
         /// privide the data as byte stream
@@ -187,33 +249,27 @@ class GeneratedSoundStream : public Stream {
         /// stop the processing
         void end() {
 	 		LOGD(__FUNCTION__);
-            generator_ptr->stop();
-        }
-
-        void flush(){
+            generator_ptr->end();
         }
 
     protected:
         SoundGenerator<T> *generator_ptr;  
 
-        int not_supported() {
-            LOGE("GeneratedSoundStream-unsupported operation!");
-            return 0;
-        } 
-
 };
 
 /**
  * @brief The Arduino Stream supports operations on single characters. This is usually not the best way to push audio information, but we 
- * will support it anyway - by using a buffer. On reads: if the buffer is empty it gets refilled - for writes
- * if it is full it gets flushed.
+ * will support it anyway - by using a buffer. Small writes are collected with memcpy and passed on as full blocks to writeExt(), 
+ * writes which are bigger than the buffer are passed on directly. Reads are served from the buffer first. If a frame size is 
+ * defined, the blocks which are passed to writeExt() or requested with readExt() are a multiple of it.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class BufferedStream : public Stream {
+class BufferedStream : public AudioStream {
     public:
-        BufferedStream(size_t buffer_size){
-            buffer = new SingleBuffer<uint8_t>(buffer_size);
+        BufferedStream(size_t buffer_size, Allocator &allocator=defaultAllocator()){
+            buffer = new SingleBuffer<uint8_t>(buffer_size, allocator);
+            block_size = buffer->size();
         }
 
         ~BufferedStream() {
@@ -224,30 +280,41 @@ class BufferedStream : public Stream {
 
         /// writes a byte to the buffer
         virtual size_t write(uint8_t c) {
-        if (buffer->isFull()){
-                flush();
-            }
-            return buffer->write(c);
+            return write(&c, 1);
         }
 
         /// Use this method: write an array
         virtual size_t write(const uint8_t* data, size_t len) {    
-            flush();
-            return writeExt(data, len);
+            size_t result = 0;
+            while (result < len){
+                size_t open = len - result;
+                if (buffer->isEmpty() && open >= (size_t) block_size){
+                    // pass on all full frames w/o copying
+                    size_t direct = fullFrames(open);
+                    size_t written = writeExt(data + result, direct);
+                    result += written;
+                    updateFrameOffset(written);
+                    if (written < direct) break;
+                } else {
+                    // collect the data until we have a full block
+                    int copy = MIN((int)open, block_size - buffer->available());
+                    result += buffer->writeArray(data + result, copy);
+                    if (buffer->available() >= block_size && !writeBuffer()){
+                        break;
+                    }
+                }
+            }
+            return result;
         }
 
         /// empties the buffer
         virtual void flush() {
-            // just dump the memory of the buffer and clear it
-            if (buffer->available()>0){
-                writeExt(buffer->address(), buffer->available());
-                buffer->reset();
-            }
+            writeBuffer();
         }
 
         /// reads a byte - to be avoided
         virtual int read() {
-        if (buffer->isEmpty()){
+            if (buffer->isEmpty()){
                 refill();
             }
             return buffer->read(); 
@@ -255,19 +322,24 @@ class BufferedStream : public Stream {
 
         /// peeks a byte - to be avoided
         virtual int peek() {
-        if (buffer->isEmpty()){
+            if (buffer->isEmpty()){
                 refill();
             }
             return buffer->peek();
         };
         
-        /// Use this method !!
+        /// Use this method !!: we provide the buffered data first 
         size_t readBytes( uint8_t *data, size_t length) { 
-            if (buffer->isEmpty()){
-                return readExt(data, length);
-            } else {
-                return buffer->readArray(data, length);
+            size_t result = buffer->readArray(data, length);
+            size_t open = length - result;
+            if (open >= (size_t) block_size){
+                // read all full frames directly
+                result += readExt(data + result, open - (open % frame_size));
+            } else if (open > 0){
+                refill();
+                result += buffer->readArray(data + result, open);
             }
+            return result;
         }
 
 
@@ -279,12 +351,52 @@ class BufferedStream : public Stream {
             return buffer->available();
         }
 
+        /// Defines the frame size in bytes (channels * bits_per_sample / 8)
+        void setFrameSize(int size) {
+            if (size<=0 || size>(int)buffer->size()) return;
+            frame_size = size;
+            block_size = buffer->size() - (buffer->size() % size);
+            frame_offset = 0;
+        }
+
     protected:
         SingleBuffer<uint8_t> *buffer=nullptr;
+        int block_size = 0;
+        int frame_size = 1;
+        // bytes of the actual frame which were already passed on to writeExt()
+        int frame_offset = 0;
+
+        /// writes all full frames of the buffer with writeExt: the data which was not written and an incomplete
+        /// frame is kept. Returns false if nothing could be written
+        bool writeBuffer() {
+            int available = buffer->available();
+            int len = fullFrames(available);
+            if (len>0){
+                size_t written = writeExt(buffer->address(), len);
+                updateFrameOffset(written);
+                int rest = available - written;
+                if (rest>0){
+                    memmove(buffer->address(), buffer->address() + written, rest);
+                }
+                buffer->reset();
+                buffer->writeCommit(rest);
+                return written > 0;
+            }
+            return true;
+        }
+
+        /// the part of len which ends at a frame boundary: the output might have accepted only a part of a frame
+        size_t fullFrames(size_t len) {
+            return len - ((len + frame_offset) % frame_size);
+        }
+
+        void updateFrameOffset(size_t written) {
+            frame_offset = (frame_offset + written) % frame_size;
+        }
 
         // refills the buffer with data from i2s
         void refill() {
-            size_t result = readExt(buffer->address(), buffer->size());
+            size_t result = readExt(buffer->address(), block_size);
             buffer->setAvailable(result);
         }
 
@@ -294,15 +406,174 @@ class BufferedStream : public Stream {
 };
 
 
+/**
+ * @brief Formats numbers into a preallocated char buffer which is written to the output with a single 
+ * write() when it is full or when flush() is called. The number conversion does not use printf or Print.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TextBuffer {
+    public:
+        TextBuffer(int size=TEXT_BUFFER_SIZE, Allocator &allocator=defaultAllocator()){
+            this->allocator = &allocator;
+            // we need space for at least one number
+            this->size = size < 32 ? 32 : size;
+            buffer = allocator.createArray<char>(this->size);
+            if (buffer==nullptr){
+                this->size = 0;
+            }
+        }
+
+        ~TextBuffer(){
+            allocator->removeArray(buffer, size);
+        }
+
+        /// Defines the output
+        void setOutput(Print &out){
+            out_ptr = &out;
+        }
+
+        /// Makes sure that we can add len chars: if necessary we write out the buffer
+        void reserve(int len){
+            if (pos + len > size){
+                flush();
+            }
+        }
+
+        /// Adds a single char
+        void add(char c){
+            reserve(1);
+            if (pos < size) buffer[pos++] = c;
+        }
+
+        /// Adds a string with the indicated length
+        void add(const char* str, int len){
+            reserve(len);
+            if (pos + len <= size){
+                memcpy(buffer + pos, str, len);
+                pos += len;
+            }
+        }
+
+        void add(int value){
+            addSigned(value);
+        }
+
+        void add(long value){
+            addSigned(value);
+        }
+
+        void add(unsigned value){
+            addUnsigned(value, false);
+        }
+
+        void add(unsigned long value){
+            addUnsigned(value, false);
+        }
+
+        /// Adds a float with the indicated number of decimals (like Print)
+        void add(double value, int digits=2){
+            reserve(32);
+            if (value < 0){
+                add('-');
+                value = -value;
+            }
+            // rounding
+            double rounding = 0.5;
+            for (int j=0;j<digits;j++){
+                rounding /= 10.0;
+            }
+            value += rounding;
+            if (value > 4294967295.0){
+                add("ovf", 3);
+                return;
+            }
+            unsigned long int_part = (unsigned long) value;
+            addUnsigned(int_part, false);
+            if (digits > 0){
+                add('.');
+                double rest = value - int_part;
+                for (int j=0;j<digits;j++){
+                    rest *= 10.0;
+                    int digit = (int) rest;
+                    add((char)('0' + digit));
+                    rest -= digit;
+                }
+            }
+        }
+
+        /// Adds the value as 2 hex digits
+        void addHex(uint8_t value){
+            static const char hex[] = "0123456789ABCDEF";
+            reserve(2);
+            if (pos + 2 <= size){
+                buffer[pos++] = hex[value >> 4];
+                buffer[pos++] = hex[value & 0xF];
+            }
+        }
+
+        /// Writes the collected text to the output
+        void flush() {
+            if (pos>0 && out_ptr!=nullptr){
+                out_ptr->write((const uint8_t*)buffer, pos);
+            }
+            pos = 0;
+        }
+
+    protected:
+        Allocator *allocator;
+        Print *out_ptr = &Serial;
+        char *buffer = nullptr;
+        int size = 0;
+        int pos = 0;
+
+        void addSigned(long value){
+            if (value < 0){
+                // negate as unsigned to support the min value
+                addUnsigned(0ul - (unsigned long)value, true);
+            } else {
+                addUnsigned(value, false);
+            }
+        }
+
+        /// converts 2 digits at a time from the end 
+        void addUnsigned(unsigned long value, bool negative){
+            static const char digits[] = 
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+            char tmp[24];
+            int idx = sizeof(tmp);
+            while (value >= 100){
+                int i = (value % 100) * 2;
+                value /= 100;
+                tmp[--idx] = digits[i + 1];
+                tmp[--idx] = digits[i];
+            }
+            if (value >= 10){
+                int i = value * 2;
+                tmp[--idx] = digits[i + 1];
+                tmp[--idx] = digits[i];
+            } else {
+                tmp[--idx] = '0' + value;
+            }
+            if (negative){
+                tmp[--idx] = '-';
+            }
+            add(tmp + idx, sizeof(tmp) - idx);
+        }
+};
+
 /**
  * @brief Stream Wrapper which can be used to print the values as readable ASCII to the screen to be analyzed in the Serial Plotter
  * The frames are separated by a new line. The channels in one frame are separated by a ,
+ * The text of a whole block is collected in a TextBuffer and written with one write().
  * @tparam T 
   * @author Phil Schatzmann
  * @copyright GPLv3
 */
 template<typename T>
-class CsvStream : public BufferedStream, public AudioBaseInfoDependent  {
+class CsvStream : public BufferedStream {
 
     public:
         CsvStream(int buffer_size=DEFAULT_BUFFER_SIZE, bool active=true) : BufferedStream(buffer_size){
@@ -312,8 +583,9 @@ class CsvStream : public BufferedStream, public AudioBaseInfoDependent  {
         /// Constructor
         CsvStream(Print &out, int channels, int buffer_size=DEFAULT_BUFFER_SIZE, bool active=true) : BufferedStream(buffer_size){
             this->channels = channels;
-            this->out_ptr = &out;
+            text.setOutput(out);
             this->active = active;
+            setFrameSize(sizeof(T) * channels);
         }
 
         void begin(){
@@ -325,13 +597,15 @@ class CsvStream : public BufferedStream, public AudioBaseInfoDependent  {
 	 		LOGD(__FUNCTION__);
             this->active = true;
             this->channels = info.channels;
+            setFrameSize(sizeof(T) * channels);
         }
 
         void begin(int channels, Print &out=Serial){
 	 		LOGD(__FUNCTION__);
             this->channels = channels;
-            this->out_ptr = &out;
+            text.setOutput(out);
             this->active = true;
+            setFrameSize(sizeof(T) * channels);
         }
 
 
@@ -345,27 +619,28 @@ class CsvStream : public BufferedStream, public AudioBaseInfoDependent  {
         virtual void setAudioInfo(AudioBaseInfo info) {
 	 		LOGD(__FUNCTION__);
             this->channels = info.channels;
+            setFrameSize(sizeof(T) * channels);
         };
 
 
     protected:
-        T *data_ptr;
-        Print *out_ptr = &Serial;
+        TextBuffer text;
         int channels = 1;
         bool active = false;
 
         virtual size_t writeExt(const uint8_t* data, size_t len) {   
             if (!active) return 0;
             size_t lenChannels = len / (sizeof(T)*channels); 
-            data_ptr = (T*)data;
-            for (int j=0;j<lenChannels;j++){
+            const T *data_ptr = (const T*)data;
+            for (size_t j=0;j<lenChannels;j++){
                 for (int ch=0;ch<channels;ch++){
-                    out_ptr->print(*data_ptr);
+                    text.add(*data_ptr);
                     data_ptr++;
-                    if (ch<channels-1) Serial.print(", ");
+                    if (ch<channels-1) text.add(", ", 2);
                 }
-                Serial.println();
+                text.add("\r\n", 2);
             }
+            text.flush();
             return len;
         }
 
@@ -376,7 +651,7 @@ class CsvStream : public BufferedStream, public AudioBaseInfoDependent  {
 };
 
 /**
- * @brief Creates a Hex Dump
+ * @brief Creates a Hex Dump: the text of a whole block is collected in a TextBuffer and written with one write().
  * 
  */
 class HexDumpStream : public BufferedStream {
@@ -388,7 +663,7 @@ class HexDumpStream : public BufferedStream {
 
         /// Constructor
         HexDumpStream(Print &out, int buffer_size=DEFAULT_BUFFER_SIZE, bool active=true) : BufferedStream(buffer_size){
-            this->out_ptr = &out;
+            text.setOutput(out);
             this->active = active;
         }
 
@@ -405,30 +680,33 @@ class HexDumpStream : public BufferedStream {
         }
 
         void flush(){
-            Serial.println();
+            BufferedStream::flush();
+            text.add("\r\n", 2);
+            text.flush();
             pos = 0;
         }
 
 
     protected:
-        Print *out_ptr = &Serial;
+        TextBuffer text;
         int pos = 0;
         bool active = false;
 
         virtual size_t writeExt(const uint8_t* data, size_t len) {   
             if (!active) return 0;
-            for (int j=0;j<len;j++){
-                out_ptr->print(data[j], HEX);
-                out_ptr->print(" ");
+            for (size_t j=0;j<len;j++){
+                text.addHex(data[j]);
+                text.add(' ');
                 pos++;
                 if (pos == 8){
-                    Serial.print(" - ");
+                    text.add(" - ", 3);
                 }
                 if (pos == 16){
-                    Serial.println();
+                    text.add("\r\n", 2);
                     pos = 0;
                 }
             }
+            text.flush();
             return len;
         }
 
@@ -481,13 +759,36 @@ class AudioOutputStream : public BufferedStream {
 };
 
 /**
- * @brief A Stream backed by a Ringbuffer. We can write to the end and read from the beginning of the stream
+ * @brief A Stream backed by a Ringbuffer. We can write to the end and read from the beginning of the stream.
+ * If the writer and the reader are running in different tasks (or in an ISR) you should use lockFree=true.
+ * On Linux the lock free buffer is a MirroredRingBuffer.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class RingBufferStream : public Stream {
+class RingBufferStream : public AudioStream {
     public:
-        RingBufferStream(int size=DEFAULT_BUFFER_SIZE) {
+        /// If the host supports it, we use the (also lock free) mirrored buffer for lockFree: the capacity is 
+        /// limited to the requested size, even if the mirrored memory is rounded up to the page size
+        RingBufferStream(int size=DEFAULT_BUFFER_SIZE, bool lockFree=false) {
+            max_size = size;
+#ifdef USE_ATOMIC
+            if (lockFree){
+#ifdef USE_MIRRORED_BUFFER
+                MirroredRingBuffer<uint8_t> *mirrored = new MirroredRingBuffer<uint8_t>(size);
+                if (mirrored->size()>0){
+                    buffer = mirrored;
+                    return;
+                }
+                delete mirrored;
+#endif
+                buffer = new AtomicRingBuffer<uint8_t>(size);
+                return;
+            }
+#else
+            if (lockFree){
+                LOGW("lock free buffer not supported");
+            }
+#endif
             buffer = new RingBuffer<uint8_t>(size);
         }
 
@@ -506,10 +807,10 @@ class RingBufferStream : public Stream {
         }
         
         virtual int peek() {
-            return buffer->peek();
+            return buffer->isEmpty() ? -1 : buffer->peek();
         }        
         virtual int read() {
-            return buffer->read();
+            return buffer->isEmpty() ? -1 : buffer->read();
         }
         
         virtual size_t readBytes(uint8_t *data, size_t length) {
@@ -518,16 +819,304 @@ class RingBufferStream : public Stream {
         
         virtual size_t write(const uint8_t *data, size_t len){
             //LOGD("RingBufferStream::write: %zu",len);
-            return buffer->writeArray(data, len);
+            return buffer->writeArray(data, MIN(len, (size_t) availableForWrite()));
         }
         
         virtual size_t 	write(uint8_t c) {
-            return buffer->write(c);
+            return availableForWrite() > 0 ? buffer->write(c) : 0;
+        }
+
+        virtual int availableForWrite() {
+            int result = buffer->availableToWrite();
+            int limit = max_size - buffer->available();
+            return MIN(result, limit);
+        }
+
+        /// Zero copy: provides the memory into which we can write directly (e.g. from a decoder)
+        BufferSpan<uint8_t> writeReserve(int len) {
+            return buffer->writeReserve(MIN(len, availableForWrite()));
+        }
+
+        /// Zero copy: confirms the number of bytes that were written into the reserved memory
+        void writeCommit(int len) {
+            buffer->writeCommit(len);
+        }
+
+        /// Zero copy: provides the memory from which we can read directly (e.g. by a driver)
+        BufferSpan<uint8_t> readPeek() {
+            return buffer->readPeek();
+        }
+
+        /// Zero copy: marks the indicated number of bytes as processed
+        void readConsume(int len) {
+            buffer->readConsume(len);
+        }
+
+        /// Provides the (requested) capacity in bytes
+        int size() {
+            return max_size;
+        }
+
+    protected:
+        BaseBuffer<uint8_t> *buffer=nullptr;
+        int max_size = 0;
+
+};
+
+/**
+ * @brief Configuration for the JitterBufferStream. All times are in ms: they are converted to bytes with the 
+ * bytes_per_second, which you can define with setAudioInfo() for PCM data or from the bit rate for encoded data.
+ */
+struct JitterBufferConfig {
+    uint32_t bytes_per_second = DEFAULT_SAMPLE_RATE * DEFAULT_CHANNELS * DEFAULT_BITS_PER_SAMPLE / 8;
+    int frame_size = 1;                                    // we read only multiples of this
+    uint32_t target_latency_ms = JITTER_TARGET_LATENCY_MS; // initial target which is adapted automatically
+    uint32_t preroll_ms = JITTER_TARGET_LATENCY_MS;        // data which is needed before the output starts
+    uint32_t min_latency_ms = JITTER_MIN_LATENCY_MS;
+    uint32_t max_latency_ms = JITTER_MAX_LATENCY_MS;
+    uint32_t adapt_interval_ms = 5000;                     // we shrink only if there was no underrun in this interval
+    bool conceal_with_silence = false;                     // PCM only: provide silence when we run out of data
+
+    /// Defines the bytes_per_second and frame_size for PCM data
+    void setAudioInfo(AudioBaseInfo info) {
+        frame_size = info.channels * info.bits_per_sample / 8;
+        bytes_per_second = info.sample_rate * frame_size;
+    }
+
+    /// Converts the indicated time to bytes (as multiple of the frame size)
+    uint32_t toBytes(uint32_t ms) {
+        uint32_t result = (uint64_t) ms * bytes_per_second / 1000;
+        return result - (result % frame_size);
+    }
+
+    /// Converts the indicated bytes to ms
+    uint32_t toMs(uint32_t bytes) {
+        return bytes_per_second == 0 ? 0 : (uint64_t) bytes * 1000 / bytes_per_second;
+    }
+
+    void logConfig() {
+        LOGI("bytes_per_second: %u", (unsigned) bytes_per_second);
+        LOGI("frame_size: %d", frame_size);
+        LOGI("target_latency_ms: %u", (unsigned) target_latency_ms);
+        LOGI("preroll_ms: %u", (unsigned) preroll_ms);
+        LOGI("min_latency_ms: %u", (unsigned) min_latency_ms);
+        LOGI("max_latency_ms: %u", (unsigned) max_latency_ms);
+        LOGI("conceal_with_silence: %s", conceal_with_silence ? "true" : "false");
+    }
+};
+
+/**
+ * @brief Statistics of the JitterBufferStream
+ */
+struct JitterBufferStats {
+    uint32_t underruns = 0;         // the buffer was empty while we were playing
+    uint32_t late_writes = 0;       // writes which arrived after an underrun
+    uint32_t late_bytes = 0;
+    uint32_t concealed_bytes = 0;   // silence which was provided instead of data
+    uint32_t jitter_ms = 0;         // estimated arrival jitter
+    uint32_t target_latency_ms = 0; // actual (adapted) target
+    uint32_t latency_ms = 0;        // actual fill level
+};
+
+/**
+ * @brief Buffer between a source with a varying arrival time (e.g. an URLStream) and the decoder or output: 
+ * The output only starts after the pre-roll data has been received. When we run out of data we wait until the 
+ * (increased) target latency has been buffered again. While playing we estimate the arrival jitter and 
+ * adapt the target latency: we grow immediately and shrink slowly if there were no underruns. The writer 
+ * is limited to 2 * target latency, so that the latency does not grow unbounded. The writer and reader can 
+ * be in different tasks.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class JitterBufferStream : public RingBufferStream {
+    public:
+        /// size: max number of bytes which also limits the max latency
+        JitterBufferStream(int size=JITTER_BUFFER_SIZE) : RingBufferStream(size, true) {
+        }
+
+        JitterBufferConfig defaultConfig() {
+            JitterBufferConfig result;
+            return result;
+        }
+
+        /// Defines the bytes per second and frame size for PCM data
+        void setAudioInfo(AudioBaseInfo info) {
+            AudioStream::setAudioInfo(info);
+            config.setAudioInfo(info);
+        }
+
+        bool begin(JitterBufferConfig cfg) {
+            config = cfg;
+            return begin();
+        }
+
+        /// (Re)starts the buffering with the actual configuration
+        bool begin() {
+	 		LOGD(__FUNCTION__);
+            config.logConfig();
+            if (config.bytes_per_second==0 || config.frame_size<=0){
+                LOGE("Invalid bytes_per_second or frame_size");
+                return false;
+            }
+            buffer->reset();
+            capacity = RingBufferStream::availableForWrite();
+            jitter_stats = JitterBufferStats();
+            target_ms = limit(config.target_latency_ms);
+            threshold_ms = config.preroll_ms;
+            is_playing = false;
+            is_started = false;
+            jitter = 0.0f;
+            last_write_ms = 0;
+            underrun_in_interval = false;
+            adapt_time = millis() + config.adapt_interval_ms;
+            return true;
+        }
+
+        /// Number of bytes which can be read: 0 while we are buffering 
+        virtual int available() {
+            if (!updateState()){
+                return isConcealing() ? config.toBytes(10) : 0;
+            }
+            int result = buffer->available();
+            return result - (result % config.frame_size);
+        }
+
+        virtual int peek() {
+            return updateState() ? buffer->peek() : -1;
+        }
+
+        virtual int read() {
+            uint8_t value;
+            return readBytes(&value, 1) == 1 ? value : -1;
+        }
+
+        /// Reads only full frames: provides silence or nothing while we are buffering 
+        virtual size_t readBytes(uint8_t *data, size_t length) {
+            if (!updateState()){
+                return conceal(data, length);
+            }
+            size_t len = MIN(length, (size_t) available());
+            return buffer->readArray(data, len);
+        }
+
+        /// Accepts data up to 2 * target latency
+        virtual size_t write(const uint8_t *data, size_t len){
+            size_t result = buffer->writeArray(data, MIN(len, (size_t) availableForWrite()));
+            // a rejected write is not an arrival
+            if (result>0){
+                updateJitter(result);
+                if (is_started && !is_playing){
+                    jitter_stats.late_writes++;
+                    jitter_stats.late_bytes += result;
+                }
+            }
+            return result;
+        }
+
+        virtual size_t write(uint8_t c) {
+            return write(&c, 1);
+        }
+
+        virtual int availableForWrite() {
+            uint32_t ms = target_ms > threshold_ms ? target_ms : threshold_ms;
+            int max_level = MIN(capacity, (int) config.toBytes(2 * ms));
+            return max(0, max_level - buffer->available());
+        }
+
+        /// Provides the actual statistics
+        JitterBufferStats stats() {
+            JitterBufferStats result = jitter_stats;
+            result.jitter_ms = jitter;
+            result.target_latency_ms = target_ms;
+            result.latency_ms = config.toMs(buffer->available());
+            return result;
+        }
+
+        /// Returns true while the data is played
+        bool isPlaying() {
+            return is_playing;
         }
 
     protected:
-        RingBuffer<uint8_t> *buffer=nullptr;
+        JitterBufferConfig config;
+        JitterBufferStats jitter_stats;
+        int capacity = 0;
+        volatile uint32_t target_ms = JITTER_TARGET_LATENCY_MS;
+        uint32_t threshold_ms = JITTER_TARGET_LATENCY_MS;
+        volatile bool is_playing = false;
+        volatile bool is_started = false;
+        volatile float jitter = 0.0f;
+        uint32_t last_write_ms = 0;
+        size_t last_write_len = 0;
+        uint32_t adapt_time = 0;
+        bool underrun_in_interval = false;
+
+        /// Determines if we are playing: handles the pre-roll, underruns and the adaption of the target
+        bool updateState() {
+            uint32_t level = buffer->available();
+            if (is_playing){
+                if (level < (uint32_t) config.frame_size){
+                    // underrun: grow and buffer again
+                    is_playing = false;
+                    jitter_stats.underruns++;
+                    underrun_in_interval = true;
+                    target_ms = limit(target_ms * 3 / 2);
+                    threshold_ms = target_ms;
+                    LOGI("JitterBufferStream underrun: new target %u ms", (unsigned) target_ms);
+                }
+            } else if (level >= config.toBytes(threshold_ms) || level >= (uint32_t) capacity){
+                is_playing = true;
+                is_started = true;
+            }
+            adapt();
+            return is_playing;
+        }
 
+        /// grow immediately if the jitter is high and shrink slowly if there were no underruns
+        void adapt() {
+            uint32_t desired = limit(3 * jitter);
+            if (desired > target_ms){
+                target_ms = desired;
+            }
+            // wrap around safe comparison
+            if ((int32_t)(millis() - adapt_time) >= 0){
+                if (!underrun_in_interval && desired < target_ms){
+                    target_ms = limit(target_ms - ((target_ms - desired) / 4));
+                }
+                underrun_in_interval = false;
+                adapt_time = millis() + config.adapt_interval_ms;
+            }
+        }
+
+        /// RFC 3550 style arrival jitter: difference between the arrival time and the play time of the last data
+        void updateJitter(size_t len) {
+            uint32_t now = millis();
+            if (is_playing && last_write_ms != 0){
+                int32_t gap = now - last_write_ms;
+                int32_t expected = config.toMs(last_write_len);
+                float deviation = abs(gap - expected);
+                jitter = jitter + ((deviation - jitter) / 16.0f);
+            }
+            last_write_ms = now;
+            last_write_len = len;
+        }
+
+        uint32_t limit(uint32_t ms) {
+            uint32_t max_ms = MIN(config.max_latency_ms, config.toMs(capacity) / 2);
+            return max(config.min_latency_ms, (uint32_t) MIN(ms, max_ms));
+        }
+
+        bool isConcealing() {
+            return config.conceal_with_silence && is_started;
+        }
+
+        size_t conceal(uint8_t *data, size_t len) {
+            if (!isConcealing()) return 0;
+            size_t result = len - (len % config.frame_size);
+            memset(data, 0, result);
+            jitter_stats.concealed_bytes += result;
+            return result;
+        }
 };
 
 /**
@@ -537,7 +1126,7 @@ class RingBufferStream : public Stream {
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class ExternalBufferStream : public Stream {
+class ExternalBufferStream : public AudioStream {
     public:
         ExternalBufferStream() {
 	 		LOGD(__FUNCTION__);
@@ -579,11 +1168,189 @@ class ExternalBufferStream : public Stream {
 
 
 /**
- * @brief A more natural Stream class to process encoded data (aac, wav, mp3...).
+ * @brief Statistics of an output of the MultiOutput
+ */
+struct MultiOutputStats {
+    uint32_t bytes_direct = 0;      // bytes which were written w/o copying
+    uint32_t bytes_queued = 0;      // bytes which needed to be queued because the output did not accept them
+    uint32_t high_watermark = 0;    // max number of queued bytes
+    uint32_t limited = 0;           // number of writes which were limited by the queue of this output
+
+    /// Prints the statistics e.g. to Serial
+    void printTo(Print &out) {
+        out.print("direct: "); out.print((unsigned long)bytes_direct);
+        out.print(" queued: "); out.print((unsigned long)bytes_queued);
+        out.print(" high: "); out.print((unsigned long)high_watermark);
+        out.print(" limited: "); out.print((unsigned long)limited);
+        out.println();
+    }
+};
+
+/**
+ * @brief Writes the same data to multiple outputs (e.g. I2S, FFT and a web server). The data is passed on 
+ * w/o copying to all outputs which consume it synchronously. If an output does not accept all data, the 
+ * remainder is stored in a small queue of this output, which is written first on the next call. 
+ * We never accept more data than the fullest queue can take, so a slow output slows down the writer
+ * and no data is lost: use bottleneck() to find the output which is limiting the throughput.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MultiOutput : public AudioStream {
+    public:
+        MultiOutput() = default;
+
+        /// Defines 2 outputs
+        MultiOutput(Print &out1, Print &out2){
+            add(out1);
+            add(out2);
+        }
+
+        ~MultiOutput(){
+            for (int j=0;j<outputs.size();j++){
+                delete outputs[j].queue;
+            }
+        }
+
+        /// Adds an output with a queue of the indicated size in bytes 
+        void add(Print &out, int queueSize=DEFAULT_BUFFER_SIZE){
+            Output output;
+            output.out = &out;
+            output.queue = new RingBuffer<uint8_t>(queueSize);
+            outputs.push_back(output);
+        }
+
+        /// Writes the data to all outputs: returns the number of bytes which were accepted by all outputs
+        virtual size_t write(const uint8_t *data, size_t len){
+            // we can only accept what fits into the fullest queue 
+            int bottleneck_idx = -1;
+            for (int j=0;j<outputs.size();j++){
+                Output &output = outputs[j];
+                writeQueue(output);
+                size_t free = output.queue->availableToWrite();
+                if (free < len){
+                    len = free;
+                    bottleneck_idx = j;
+                }
+            }
+            if (bottleneck_idx>=0){
+                outputs[bottleneck_idx].stats.limited++;
+            }
+
+            for (int j=0;j<outputs.size() && len>0;j++){
+                Output &output = outputs[j];
+                size_t written = 0;
+                // keep the sequence: only write directly if nothing is queued
+                if (output.queue->available()==0){
+                    written = output.out->write(data, len);
+                    output.stats.bytes_direct += written;
+                }
+                if (written < len){
+                    int queued = output.queue->writeArray(data + written, len - written);
+                    output.stats.bytes_queued += queued;
+                    if ((uint32_t)output.queue->available() > output.stats.high_watermark){
+                        output.stats.high_watermark = output.queue->available();
+                    }
+                }
+            }
+            return len;
+        }
+
+        virtual size_t write(uint8_t c) {
+            return write(&c, 1);
+        }
+
+        /// Provides the number of bytes that can be written to all outputs w/o blocking
+        virtual int availableForWrite() {
+            int result = outputs.empty() ? 0 : outputs[0].queue->availableToWrite();
+            for (int j=1;j<outputs.size();j++){
+                result = MIN(result, outputs[j].queue->availableToWrite());
+            }
+            return result;
+        }
+
+        /// Writes the queued data to the outputs
+        virtual void flush() {
+            for (int j=0;j<outputs.size();j++){
+                writeQueue(outputs[j]);
+                outputs[j].out->flush();
+            }
+        }
+
+        /// Provides the index of the output which is the slowest one (with the most limited writes and queued data) - or -1 if there are no outputs
+        int bottleneck() {
+            int result = -1;
+            for (int j=0;j<outputs.size();j++){
+                MultiOutputStats &stats = outputs[j].stats;
+                if (result==-1 || stats.limited > outputs[result].stats.limited 
+                || (stats.limited == outputs[result].stats.limited && stats.high_watermark > outputs[result].stats.high_watermark)){
+                    result = j;
+                }
+            }
+            return result;
+        }
+
+        /// Provides the statistics of the indicated output
+        MultiOutputStats &stats(int idx) {
+            return outputs[idx].stats;
+        }
+
+        /// Provides the number of bytes which are queued for the indicated output
+        int queued(int idx) {
+            return outputs[idx].queue->available();
+        }
+
+        /// Provides the number of outputs
+        int size() {
+            return outputs.size();
+        }
+
+        /// not supported
+        virtual int available() {
+            return 0;
+        }
+
+        /// not supported
+        virtual int read() {
+            return -1;
+        }
+
+        /// not supported
+        virtual int peek() {
+            return -1;
+        }
+
+        /// not supported
+        virtual size_t readBytes(uint8_t *data, size_t length) {
+            return 0;
+        }
+
+    protected:
+        struct Output {
+            Print *out = nullptr;
+            RingBuffer<uint8_t> *queue = nullptr;
+            MultiOutputStats stats;
+        };
+        Vector<Output> outputs;
+
+        // writes the queued data directly from the queue memory
+        void writeQueue(Output &output){
+            while(output.queue->available()>0){
+                BufferSpan<uint8_t> span = output.queue->readPeek();
+                size_t written = output.out->write(span.data, span.size);
+                output.queue->readConsume(written);
+                if (written < (size_t) span.size) break;
+            }
+        }
+};
+
+/**
+ * @brief A more natural Stream class to process encoded data (aac, wav, mp3...). 
+ * In pull mode (decoder and input stream are defined in the constructor) the decoded data can be read: 
+ * the encoded data is read from the input stream and decoded into a bounded queue only when it is requested. 
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class EncodedAudioStream : public Stream { 
+class EncodedAudioStream : public AudioStream { 
     public: 
         /**
          * @brief Construct a new Encoded Stream object - used for decoding
@@ -613,6 +1380,32 @@ class EncodedAudioStream : public Stream {
             active = false;
         }
 
+        /**
+         * @brief Construct a new Encoded Audio Stream object - used for decoding in pull mode: the 
+         * decoded data is provided with readBytes()
+         * 
+         * @param decoder 
+         * @param inputStream source of the encoded data
+         * @param queueSize max number of decoded bytes which are kept: this must be able to hold the result of 2 decoder calls
+         */
+        EncodedAudioStream(AudioDecoder &decoder, Stream &inputStream, int queueSize=DEFAULT_BUFFER_SIZE*16) {
+	 		LOGD(__FUNCTION__);
+            setupPullMode(&decoder, inputStream, queueSize);
+        }
+
+        /**
+         * @brief Construct a new Encoded Audio Stream object - used for decoding in pull mode: the 
+         * decoded data is provided with readBytes()
+         * 
+         * @param decoder 
+         * @param inputStream source of the encoded data
+         * @param queueSize max number of decoded bytes which are kept: this must be able to hold the result of 2 decoder calls
+         */
+        EncodedAudioStream(AudioDecoder *decoder, Stream &inputStream, int queueSize=DEFAULT_BUFFER_SIZE*16) {
+	 		LOGD(__FUNCTION__);
+            setupPullMode(decoder, inputStream, queueSize);
+        }
+
         /**
          * @brief Construct a new Encoded Audio Stream object - used for encoding
          * 
@@ -649,6 +1442,12 @@ class EncodedAudioStream : public Stream {
             if (write_buffer!=nullptr){
                 delete [] write_buffer;
             }
+            if (read_buffer!=nullptr){
+                delete [] read_buffer;
+            }
+            if (queue!=nullptr){
+                delete queue;
+            }
         }
 
         /// Define object which need to be notified if the basinfo is changing
@@ -663,6 +1462,13 @@ class EncodedAudioStream : public Stream {
             decoder_ptr->begin();
             encoder_ptr->begin();
             active = true;
+            input_ended = false;
+        }
+
+        /// Pull mode: informs that the input stream will not provide any more data, so that the data which is 
+        /// still buffered in the decoder can be decoded. An empty input is otherwise treated as a temporary stall.
+        void endOfInput() {
+            input_ended = true;
         }
 
         /// Ends the processing
@@ -673,9 +1479,11 @@ class EncodedAudioStream : public Stream {
             active = false;
         }
 
-        /// note: always return 0!
+        /// Pull mode: decodes ahead up to half of the queue and provides the number of decoded bytes - otherwise 0
         virtual int available(){
-            return 0;
+            if (queue==nullptr) return 0;
+            decode(queue_size / 2);
+            return queue->available();
         }
         
         /// writes out any buffered data
@@ -686,19 +1494,25 @@ class EncodedAudioStream : public Stream {
             }
         }
         
-        /// not implemented
+        /// Pull mode: provides the next decoded byte w/o removing it
         virtual int peek() {
-            return -1;
+            if (queue==nullptr) return -1;
+            decode(1);
+            return queue->peek();
         }     
 
-        /// not implemented
+        /// Pull mode: provides the next decoded byte
         virtual int read() {
-            return -1;
+            if (queue==nullptr) return -1;
+            decode(1);
+            return queue->read();
         }
         
-        /// not implemented
+        /// Pull mode: provides the decoded data - the decoder is only called if the queue does not contain enough data
         virtual size_t readBytes(uint8_t *data, size_t length) {
-            return 0;
+            if (queue==nullptr) return 0;
+            decode(length);
+            return queue->readBytes(data, length);
         }
         
         /// encode the data
@@ -722,8 +1536,12 @@ class EncodedAudioStream : public Stream {
             return 0;
         }
 
-        /// Returns true if status is active and we still have data to be processed
+        /// Returns true if status is active and we still have data to be processed: in pull mode this is the
+        /// case until the end of the input was reported with endOfInput() and all decoded data was read
         operator bool() {
+            if (queue!=nullptr){
+                return active && (available()>0 || !input_ended);
+            }
             return active;
         }
 
@@ -743,32 +1561,93 @@ class EncodedAudioStream : public Stream {
         AudioEncoder *encoder_ptr = CodecNOP::instance();  // decoder
         AudioWriter *writer_ptr = nullptr ;
 
-        Stream *input_ptr; // data source for encoded data
+        Stream *input_ptr = nullptr; // data source for encoded data
         uint8_t *write_buffer = nullptr;
         int write_buffer_pos = 0;
         const int write_buffer_size = 256;
         bool active;
+        // pull mode
+        RingBufferStream *queue = nullptr;  // decoded data
+        int queue_size = 0;
+        uint8_t *read_buffer = nullptr;     // encoded data 
+        const int read_buffer_size = 512;
+        bool is_decoder_flushed = true;
+        bool input_ended = false;
+
+        void setupPullMode(AudioDecoder *decoder, Stream &inputStream, int queueSize){
+            queue = new RingBufferStream(queueSize);
+            queue_size = queue->availableForWrite();
+            decoder_ptr = decoder;
+            decoder_ptr->setOutputStream(*queue);
+            writer_ptr = decoder_ptr;
+            input_ptr = &inputStream;
+            active = false;
+        }
+
+        /// Pull mode: feeds the decoder until we have the requested number of decoded bytes or the input is empty.
+        /// We only feed the decoder if at least half of the queue is free, so that the result can not get lost
+        void decode(size_t requested){
+            if (!active) return;
+            if (read_buffer == nullptr){
+                read_buffer = new uint8_t[read_buffer_size];
+            }
+            while ((size_t) queue->available() < requested && queue->availableForWrite() >= queue_size / 2){
+                // available() is only called once: it can change between calls
+                int len = input_ptr->available();
+                len = MIN(len, read_buffer_size);
+                if (len>0){
+                    len = input_ptr->readBytes(read_buffer, len);
+                }
+                if (len<=0) {
+                    // end of input: we decode the data which is still buffered in the decoder 
+                    if (input_ended && queue->available()==0 && !is_decoder_flushed){
+                        is_decoder_flushed = true;
+                        decoder_ptr->write(read_buffer, 0);
+                        continue;
+                    }
+                    break;
+                }
+                decoder_ptr->write(read_buffer, len);
+                is_decoder_flushed = false;
+            }
+        }
         
 };
 
 
-/**
- * @brief AudioOutput class which stores the data in a temporary buffer. 
- * The buffer can be consumed e.g. by a callback function by calling read();
+/// Defines what a CallbackStream provides if the producer did not provide enough data
+enum UnderrunMode { UNDERRUN_SILENCE, UNDERRUN_REPEAT, UNDERRUN_HOLD };
 
+/**
+ * @brief Bridge between a producer which writes the data and a pull based consumer (e.g. the A2DP source
+ * callback, the PortAudio callback or Mozzi) which requests the data in its callback: the data is 
+ * exchanged in whole buffers w/o locking. 
+ * 
+ * The producer can fill the buffers in place with getWriteBuffer() and commit() or just use write().
+ * The consumer can process the buffers in place with getReadBuffer() and release() or use readSamples(),
+ * which always provides the requested number of samples: if there is not enough data we fill the rest 
+ * according to the UnderrunMode with silence, by repeating the last buffer or by holding the last frame.
+ * The sizes of the buffer api are in samples of type T.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
 template <class T>
 class CallbackStream :  public BufferedStream {
     public:
-        // Default constructor
-        CallbackStream(int bufferSize, int bufferCount ):BufferedStream(bufferSize) {
+        /// bufferSize is the number of samples of a buffer, channels is used to hold the last frame
+        CallbackStream(int bufferSize, int bufferCount, UnderrunMode mode=UNDERRUN_SILENCE, int channels=2):BufferedStream(bufferSize * sizeof(T)) {
             callback_buffer_ptr = new NBuffer<T>(bufferSize, bufferCount);
+            buffer_size = bufferSize;
+            this->channels = channels > 0 ? channels : 1;
+            setFrameSize(sizeof(T));
+            setUnderrunMode(mode);
         }
 
         virtual ~CallbackStream() {    
             delete callback_buffer_ptr;
+            if (last_buffer!=nullptr){
+                delete [] last_buffer;
+            }
         }
 
         /// Activates the output
@@ -783,17 +1662,108 @@ class CallbackStream :  public BufferedStream {
             return true;
         };
 
+        /// Defines what we provide in readSamples() if there is not enough data
+        void setUnderrunMode(UnderrunMode mode) {
+            underrun_mode = mode;
+            if (mode != UNDERRUN_SILENCE && last_buffer==nullptr){
+                last_buffer = new T[buffer_size];
+                memset(last_buffer, 0, buffer_size * sizeof(T));
+            }
+        }
+
+        /// Producer: provides the free area of the actual buffer which can be filled in place
+        BufferSpan<T> getWriteBuffer() {
+            return callback_buffer_ptr->writeReserve(buffer_size);
+        }
+
+        /// Producer: confirms the number of samples that were written into the write buffer: a full buffer is passed to the consumer
+        void commit(int samples) {
+            callback_buffer_ptr->writeCommit(samples);
+        }
+
+        /// Consumer: provides the unread area of the actual buffer
+        BufferSpan<T> getReadBuffer() {
+            return callback_buffer_ptr->readPeek();
+        }
+
+        /// Consumer: marks the samples as processed: an empty buffer is given back to the producer
+        void release(int samples) {
+            callback_buffer_ptr->readConsume(samples);
+        }
+
+        /// Consumer: provides always the requested number of samples e.g. in a callback - an underrun is handled according to the UnderrunMode
+        size_t readSamples(T* data, size_t samples) {
+            size_t result = active ? readData(data, samples) : 0;
+            if (result < samples){
+                underrun_count++;
+                fillUnderrun(data, result, samples);
+            }
+            return samples;
+        }
+
+        /// Provides the number of readSamples() calls which could not be served from the buffers
+        uint32_t underruns() {
+            return underrun_count;
+        }
+
+        /// Provides the number of samples which can be read w/o underrun from the actual buffer
+        int availableSamples() {
+            return callback_buffer_ptr->available();
+        }
     
   protected:
         NBuffer<T> *callback_buffer_ptr;
-        bool active;
+        bool active = false;
+        int buffer_size;
+        int channels;
+        UnderrunMode underrun_mode = UNDERRUN_SILENCE;
+        T *last_buffer = nullptr;   // copy of the last buffer for repeat and hold
+        int last_pos = 0;
+        uint32_t underrun_count = 0;
 
         virtual size_t writeExt(const uint8_t* data, size_t len) {    
-            return callback_buffer_ptr->writeArray(data, len/sizeof(T));
+            return callback_buffer_ptr->writeArray((const T*)data, len/sizeof(T)) * sizeof(T);
         }
 
         virtual size_t readExt( uint8_t *data, size_t len) { 
-            return callback_buffer_ptr->readArray(data, len/sizeof(T));;
+            return readData((T*)data, len/sizeof(T)) * sizeof(T);
+        }
+
+        /// copies the data directly from the buffers: for repeat and hold we keep the last buffer
+        size_t readData(T* data, size_t samples){
+            size_t result = callback_buffer_ptr->readArray(data, samples);
+            if (last_buffer!=nullptr && result>0){
+                // we keep the last buffer_size samples in a ring 
+                size_t n = MIN(result, (size_t) buffer_size);
+                const T* src = data + result - n;
+                size_t first = MIN(n, (size_t) (buffer_size - last_pos));
+                memcpy(last_buffer + last_pos, src, first * sizeof(T));
+                memcpy(last_buffer, src + first, (n - first) * sizeof(T));
+                last_pos = (last_pos + n) % buffer_size;
+            }
+            return result;
+        }
+
+        /// fills the missing samples 
+        void fillUnderrun(T* data, size_t from, size_t to){
+            switch(underrun_mode){
+                case UNDERRUN_SILENCE:
+                    memset(data+from, 0, (to-from) * sizeof(T));
+                    break;
+                case UNDERRUN_REPEAT:
+                    for (size_t j=from;j<to;j++){
+                        data[j] = last_buffer[last_pos];
+                        last_pos = (last_pos + 1) % buffer_size;
+                    }
+                    break;
+                case UNDERRUN_HOLD:
+                    for (size_t j=from;j<to;j++){
+                        // last frame in the ring of the last samples
+                        int frame_pos = last_pos - channels + (j % channels);
+                        data[j] = last_buffer[frame_pos < 0 ? frame_pos + buffer_size : frame_pos];
+                    }
+                    break;
+            }
         }
 
 };
@@ -809,7 +1779,7 @@ class CallbackStream :  public BufferedStream {
  * @copyright GPLv3
  */
 
-class AnalogAudioStream : public BufferedStream, public AudioBaseInfoDependent  {
+class AnalogAudioStream : public BufferedStream {
 
     public:
         AnalogAudioStream() : BufferedStream(DEFAULT_BUFFER_SIZE){
@@ -867,7 +1837,7 @@ class AnalogAudioStream : public BufferedStream, public AudioBaseInfoDependent
  * @copyright GPLv3
  */
 
-class I2SStream : public BufferedStream, public AudioBaseInfoDependent  {
+class I2SStream : public BufferedStream {
 
     public:
         I2SStream(int mute_pin=PIN_I2S_MUTE) : BufferedStream(DEFAULT_BUFFER_SIZE){
@@ -885,6 +1855,7 @@ class I2SStream : public BufferedStream, public AudioBaseInfoDependent  {
 
         void begin(I2SConfig cfg) {
             i2s.begin(cfg);
+            setFrameSize(cfg.channels * cfg.bits_per_sample / 8);
             // unmute
             mute(false);
         }
@@ -904,8 +1875,10 @@ class I2SStream : public BufferedStream, public AudioBaseInfoDependent  {
                 cfg.bits_per_sample = info.bits_per_sample;
                 cfg.channels = info.channels;
 
+                flush();
                 i2s.end();
                 i2s.begin(cfg);        
+                setFrameSize(cfg.channels * cfg.bits_per_sample / 8);
             }
         }
 
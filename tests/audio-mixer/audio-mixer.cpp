@@ -0,0 +1,280 @@
+// Tests the AudioMixer: we compare the optimized kernel with the scalar implementation, check the 
+// saturation and measure how much of a core we need to mix 8 stereo 16 bit inputs at 48 kHz
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;  
+
+const int sample_rate = 48000;
+const int channels = 2;
+const int inputs = 8;
+const int seconds = 10;
+
+// Endless input which repeats the same data
+class LoopingInput : public Stream {
+    public:
+        LoopingInput(int16_t *data, size_t samples) {
+            this->data = (uint8_t*) data;
+            this->size = samples * sizeof(int16_t);
+        }
+        int available() { return size; }
+        size_t readBytes(uint8_t *buffer, size_t len) {
+            size_t result = 0;
+            while (result < len){
+                size_t n = MIN(len - result, size - pos);
+                memcpy(buffer + result, data + pos, n);
+                pos = (pos + n) % size;
+                result += n;
+            }
+            return result;
+        }
+        int read() { 
+            int result = data[pos];
+            pos = (pos + 1) % size;
+            return result;
+        }
+        int peek() { return data[pos]; }
+        size_t write(uint8_t) { return 0; }
+        void flush() {}
+    protected:
+        uint8_t *data;
+        size_t size;
+        size_t pos = 0;
+};
+
+// Input which provides at most max_len bytes per call: so we get incomplete frames
+class ChunkedInput : public LoopingInput {
+    public:
+        ChunkedInput(int16_t *data, size_t samples, size_t maxLen) : LoopingInput(data, samples) {
+            max_len = maxLen;
+        }
+        size_t readBytes(uint8_t *buffer, size_t len) {
+            return LoopingInput::readBytes(buffer, MIN(len, max_len));
+        }
+    protected:
+        size_t max_len;
+};
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void testKernel() {
+    const int n = 1001;
+    int16_t in[n];
+    int32_t acc[n];
+    int32_t acc_scalar[n];
+    int16_t out[n];
+    int16_t out_scalar[n];
+    memset(acc, 0, sizeof(acc));
+    memset(acc_scalar, 0, sizeof(acc_scalar));
+    for (int k=0;k<inputs;k++){
+        // includes the unity gain
+        int32_t gain = k==0 ? 32768 : (int16_t) rand();
+        for (int j=0;j<n;j++){
+            in[j] = rand();
+        }
+        MixerKernel::add(acc, in, gain, n);
+        MixerKernel::addScalar(acc_scalar, in, gain, n);
+    }
+    MixerKernel::store(out, acc, n);
+    MixerKernel::storeScalar(out_scalar, acc_scalar, n);
+    check(memcmp(acc, acc_scalar, sizeof(acc))==0 && memcmp(out, out_scalar, sizeof(out))==0, "kernel == scalar");
+}
+
+void testSaturation() {
+    int16_t high[64];
+    int16_t low[64];
+    for (int j=0;j<64;j++){
+        high[j] = 30000;
+        low[j] = -30000;
+    }
+    LoopingInput in1(high, 64), in2(high, 64), in3(low, 32);
+    AudioMixer mixer;
+    mixer.add(in1);
+    mixer.add(in2);
+    int16_t result[64];
+    check(mixer.readBytes((uint8_t*)result, sizeof(result))==sizeof(result) && result[0]==32767 && result[63]==32767, "saturation");
+
+    mixer.add(in3, 0.5);
+    mixer.setGain(0, 0.5);
+    mixer.readBytes((uint8_t*)result, sizeof(result));
+    // 30000 * 0.5 + 30000 * 1.0 - 30000 * 0.5 in Q15
+    check(result[0]==15000 + 30000 - 15000, "gains");
+
+    // the unity gain does not change the samples
+    AudioMixer unity;
+    unity.add(in1);
+    unity.readBytes((uint8_t*)result, sizeof(result));
+    check(unity.gainQ15(0)==32768 && result[0]==30000 && result[63]==30000, "unity gain");
+}
+
+void testFrames() {
+    // stereo input with left = 1000, right = -1000 which provides 3 bytes per call
+    int16_t stereo[64];
+    for (int j=0;j<64;j+=2){
+        stereo[j] = 1000;
+        stereo[j+1] = -1000;
+    }
+    ChunkedInput in1(stereo, 64, 3), in2(stereo, 64, 3);
+    AudioMixer mixer;
+    mixer.add(in1, 0.5);
+    mixer.add(in2, 0.5);
+    bool ok = true;
+    size_t total = 0;
+    for (int k=0;k<20;k++){
+        int16_t result[64];
+        // odd length: we only get complete frames
+        size_t len = mixer.readBytes((uint8_t*)result, 31);
+        ok = ok && len % 4 == 0;
+        for (size_t j=0;j<len/2;j+=2){
+            ok = ok && result[j]==1000 && result[j+1]==-1000;
+        }
+        total += len;
+    }
+    check(ok && total>0, "frames");
+
+    // mono: a frame is one sample
+    int16_t mono[32];
+    for (int j=0;j<32;j++){
+        mono[j] = j;
+    }
+    ChunkedInput in3(mono, 32, 3);
+    AudioMixer mono_mixer;
+    AudioBaseInfo info;
+    info.channels = 1;
+    info.bits_per_sample = 16;
+    mono_mixer.setAudioInfo(info);
+    mono_mixer.add(in3);
+    int16_t result[32];
+    size_t count = 0;
+    while (count < 32){
+        count += mono_mixer.readBytes((uint8_t*)(result+count), (32-count)*sizeof(int16_t)) / sizeof(int16_t);
+    }
+    ok = true;
+    for (int j=0;j<32;j++){
+        ok = ok && result[j]==j;
+    }
+    check(ok, "mono");
+}
+
+void testLateInput() {
+    // input 1 is always ready, input 2 is fed in steps: a late input must not be replaced by silence
+    int16_t one[64];
+    for (int j=0;j<64;j++){
+        one[j] = 1000;
+    }
+    LoopingInput in1(one, 64);
+    RingBufferStream in2(1024);
+    AudioMixer mixer;
+    mixer.add(in1);
+    mixer.add(in2);
+    int16_t result[64];
+    check(mixer.available()==0 && mixer.readBytes((uint8_t*)result, sizeof(result))==0, "wait for late input");
+
+    bool ok = true;
+    int16_t value = 0;
+    for (int k=0;k<10;k++){
+        // 6 frames per step
+        int16_t data[12];
+        for (int j=0;j<12;j++){
+            data[j] = value + (j/2);
+        }
+        in2.write((uint8_t*)data, sizeof(data));
+        size_t len = mixer.readBytes((uint8_t*)result, sizeof(result));
+        ok = ok && len==sizeof(data);
+        for (size_t j=0;j<len/2;j++){
+            ok = ok && result[j]==1000 + value + (int16_t)(j/2);
+        }
+        value += 6;
+    }
+    check(ok, "aligned inputs");
+
+    // after the end of input 2 we continue with silence
+    in2.write((uint8_t*)one, 8);
+    mixer.endOfInput(1);
+    size_t len = mixer.readBytes((uint8_t*)result, sizeof(result));
+    check(mixer.isEnded(1) && len==sizeof(result) && result[0]==2000 && result[3]==2000 && result[4]==1000 && result[63]==1000, "ended input");
+}
+
+void benchmark() {
+    const int samples = 4800 * channels;
+    static int16_t data[inputs][samples];
+    Vector<LoopingInput*> streams;
+    AudioMixer mixer;
+    for (int k=0;k<inputs;k++){
+        for (int j=0;j<samples;j++){
+            data[k][j] = 8000.0 * sin(2.0 * PI * (k+1) * 110.0 * (j/channels) / sample_rate);
+        }
+        streams.push_back(new LoopingInput(data[k], samples));
+        mixer.add(*streams[k], 0.3);
+    }
+
+    uint8_t buffer[1024];
+    size_t total = (size_t) sample_rate * channels * sizeof(int16_t) * seconds;
+    size_t processed = 0;
+    unsigned long start = micros();
+    while (processed < total){
+        processed += mixer.readBytes(buffer, sizeof(buffer));
+    }
+    unsigned long us = micros() - start;
+    Serial.print("mixing ");
+    Serial.print(seconds);
+    Serial.print(" s of 8 stereo inputs took ");
+    Serial.print(us / 1000);
+    Serial.print(" ms = ");
+    Serial.print(100.0 * us / (seconds * 1000000.0), 3);
+    Serial.println(" % of a core");
+    check(us < seconds * 1000000ul / 10, "< 10% of a core");
+    for (int k=0;k<inputs;k++){
+        delete streams[k];
+    }
+}
+
+// compares the optimized kernel with the scalar implementation
+void benchmarkKernel() {
+    const int n = 480;
+    static int16_t in[n];
+    static int32_t acc[n];
+    static int16_t out[n];
+    const int loops = 100 * seconds;
+    unsigned long start = micros();
+    for (int j=0;j<loops;j++){
+        for (int k=0;k<inputs;k++) MixerKernel::add(acc, in, 10000, n);
+        MixerKernel::store(out, acc, n);
+    }
+    unsigned long us = micros() - start;
+    start = micros();
+    for (int j=0;j<loops;j++){
+        for (int k=0;k<inputs;k++) MixerKernel::addScalar(acc, in, 10000, n);
+        MixerKernel::storeScalar(out, acc, n);
+    }
+    unsigned long us_scalar = micros() - start;
+    Serial.print("kernel: ");
+    Serial.print(us);
+    Serial.print(" us - scalar: ");
+    Serial.print(us_scalar);
+    Serial.println(" us");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+}
+
+void loop(){
+  testKernel();
+  testSaturation();
+  testFrames();
+  testLateInput();
+  benchmark();
+  benchmarkKernel();
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
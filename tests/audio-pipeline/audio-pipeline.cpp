@@ -0,0 +1,188 @@
+// Processes a wav file with an AudioPipeline: wav decoder -> converter (switch sign) -> effect (half volume) -> sink
+// We check the result, the propagation of the audio format and that process() does not allocate any memory.
+// We also check that a decoder with a high expansion (like a low bit rate MP3) or which provides the result of 
+// many writes at once (like the MP3DecoderMini) does not lose any data
+#include "Arduino.h"
+#include "AudioTools.h"
+#include "AudioCodecs/CodecMP3Mini.h"
+#include "../mp3-mini/BabyElephantWalk60_mp3.h"
+
+using namespace audio_tools;  
+
+const int frames = 44100;
+int16_t pcm[frames][2];
+
+// Converter which inverts the signal
+class Inverter : public BaseConverter<int16_t> {
+    public:
+        void convert(int16_t (*src)[2], size_t size) {
+            for (size_t j=0;j<size;j++){
+                src[j][0] = -src[j][0];
+                src[j][1] = -src[j][1];
+            }
+        }
+};
+
+// Effect which halves the volume: the result is written into the output buffer
+class HalfVolume : public PipelineStage {
+    public:
+        size_t process(uint8_t *data, size_t len, uint8_t *out, size_t outSize) {
+            int16_t *in_samples = (int16_t*) data;
+            int16_t *out_samples = (int16_t*) out;
+            for (size_t j=0;j<len/2;j++){
+                out_samples[j] = in_samples[j] / 2;
+            }
+            return len;
+        }
+};
+
+// Decoder which provides 100 bytes for each input byte
+class ExpandingDecoder : public AudioDecoder {
+    public:
+        void setOutputStream(Print &out) { this->out = &out; }
+        void begin() {}
+        void end() {}
+        AudioBaseInfo audioInfo() { AudioBaseInfo info; return info; }
+        void setNotifyAudioChange(AudioBaseInfoDependent &bi) {}
+        operator boolean() { return true; }
+        size_t write(const void *data, size_t len) {
+            const uint8_t *in = (const uint8_t*) data;
+            uint8_t frame[100];
+            for (size_t j=0;j<len;j++){
+                memset(frame, in[j], sizeof(frame));
+                out->write(frame, sizeof(frame));
+            }
+            return len;
+        }
+    protected:
+        Print *out = nullptr;
+};
+
+// Output which just counts the bytes
+class CountingPrint : public Print {
+    public:
+        size_t write(uint8_t) { count++; return 1; }
+        size_t write(const uint8_t *data, size_t len) { count += len; return len; }
+        size_t count = 0;
+};
+
+// Receives the audio format of the sink
+class FormatInfo : public AudioBaseInfoDependent {
+    public:
+        void setAudioInfo(AudioBaseInfo info) {
+            this->info = info;
+        }
+        AudioBaseInfo info;
+};
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void testExpansion() {
+  const int size = 3000;
+  MemoryStream encoded(size);
+  for (int j=0;j<size;j++){
+      encoded.write(j % 256);
+  }
+  MemoryStream decoded(size * 100);
+  ExpandingDecoder decoder;
+  AudioPipeline pipeline(encoded, decoded);
+  pipeline.add(decoder);
+  check(pipeline.begin(1024), "begin expansion");
+  while(pipeline.process()>0);
+  bool ok = decoded.size()==size*100 && pipeline.stats(0).overflows==0;
+  for (int j=0; ok && j<size*100; j++){
+      ok = decoded.read() == (j / 100) % 256;
+  }
+  check(ok, "expansion");
+  pipeline.end();
+}
+
+void testMP3() {
+  // push decoding of the whole file
+  CountingPrint expected;
+  MP3DecoderMini push_decoder;
+  push_decoder.setOutputStream(expected);
+  push_decoder.begin();
+  push_decoder.write(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3_len);
+  push_decoder.end();
+
+  // the decoder buffers the input and decodes it at once when the buffer is full
+  MemoryStream mp3(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3_len);
+  CountingPrint actual;
+  MP3DecoderMini decoder;
+  AudioPipeline pipeline(mp3, actual);
+  pipeline.add(decoder);
+  check(pipeline.begin(512), "begin mp3");
+  while(pipeline.process()>0);
+  pipeline.end();
+  Serial.print("mp3 pipeline: ");
+  Serial.print((long)actual.count);
+  Serial.print(" bytes - push decoding: ");
+  Serial.println((long)expected.count);
+  check(expected.count>0 && actual.count==expected.count && pipeline.stats(0).overflows==0, "mp3");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+  for (int j=0;j<frames;j++){
+      pcm[j][0] = 10000.0 * sin(2.0 * PI * 440.0 * j / 44100.0);
+      pcm[j][1] = -pcm[j][0];
+  }
+}
+
+void loop(){
+  // create wav file
+  MemoryStream wav(1024, defaultAllocator(), true);
+  WAVEncoder encoder(wav);
+  WAVAudioInfo wav_info = encoder.defaultConfig();
+  wav_info.sample_rate = 44100;
+  wav_info.channels = 2;
+  wav_info.bits_per_sample = 16;
+  encoder.begin(wav_info);
+  encoder.write((uint8_t*)pcm, sizeof(pcm));
+
+  // process it 
+  MemoryStream result(sizeof(pcm));
+  WAVDecoder decoder;
+  Inverter inverter;
+  HalfVolume half;
+  FormatInfo format;
+  AudioPipeline pipeline(wav, result);
+  pipeline.add(decoder).add(inverter).add(half);
+  pipeline.setNotifyAudioChange(format);
+  check(pipeline.begin(), "begin");
+
+  uint32_t allocations = defaultAllocator().allocations();
+  while(pipeline.process()>0);
+  check(defaultAllocator().allocations() == allocations, "no allocations in process()");
+  check(format.info.sample_rate==44100 && format.info.channels==2, "audio format propagated");
+  check(pipeline.audioInfo()==format.info, "audioInfo");
+
+  // check result
+  int16_t expected[2];
+  int16_t actual[2];
+  bool ok = result.size() == sizeof(pcm);
+  for (int j=0; ok && j<frames; j++){
+      expected[0] = -pcm[j][0] / 2;
+      expected[1] = -pcm[j][1] / 2;
+      result.readBytes((uint8_t*)actual, sizeof(actual));
+      ok = memcmp(expected, actual, sizeof(actual))==0;
+  }
+  check(ok, "result");
+  pipeline.printStats(Serial);
+  pipeline.end();
+
+  testExpansion();
+  testMP3();
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,104 @@
+// Copies data with StreamCopy into a small RingBufferStream: because the output is an AudioStream each copy is 
+// limited to its availableForWrite(), so a full output returns immediately instead of blocking. We also check
+// the available() of the GeneratedSoundStream and the single character operations of the AudioStream base class.
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;  
+
+uint8_t input[100000];
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+  for (size_t j=0;j<sizeof(input);j++){
+      input[j] = rand();
+  }
+}
+
+void loop(){
+  // generated sound is only available while the generator is active
+  SineWaveGenerator<int16_t> sine;
+  GeneratedSoundStream<int16_t> sound(sine);
+  check(sound.available()==0 && sound.availableForWrite()==0, "generator inactive");
+  sound.begin();
+  check(sound.available()>0, "generator active");
+  sound.end();
+
+  // copy into a small output which is drained slowly
+  MemoryStream in(input, sizeof(input));
+  RingBufferStream out(1000);
+  MemoryStream result(sizeof(input));
+  StreamCopy copier(out, in, 1024);
+  uint8_t buffer[300];
+  unsigned long start = millis();
+  int full_count = 0;
+  bool sized = true;
+  while (in.available()>0){
+      // we copy faster than we drain, so the output gets full
+      for (int j=0;j<2;j++){
+          int space = out.availableForWrite();
+          size_t len = copier.copy();
+          if (len > (size_t) space) sized = false;
+          if (len==0) full_count++;
+      }
+      result.write(buffer, out.readBytes(buffer, sizeof(buffer)));
+  }
+  while (out.available()>0){
+      result.write(buffer, out.readBytes(buffer, sizeof(buffer)));
+  }
+  unsigned long ms = millis() - start;
+  check(sized, "copy limited to availableForWrite");
+  check(full_count>0, "copy into full output");
+  check(ms < 100, "copy does not block");
+  check(result.size()==sizeof(input), "size");
+  uint8_t *copied = new uint8_t[sizeof(input)];
+  result.readBytes(copied, sizeof(input));
+  check(memcmp(copied, input, sizeof(input))==0, "data");
+  delete[] copied;
+
+  // a full MemoryStream does not accept any more data
+  check(result.availableForWrite()==0, "memory full");
+  MemoryStream growable(1000, defaultAllocator(), true);
+  check(growable.availableForWrite()==1000, "memory growable");
+
+  // the blocks of a BufferPool are aligned, even if the requested block size is odd
+  BufferPool pool(10, 3, false);
+  bool aligned = pool.blockSize()>=10;
+  for (int j=0;j<3;j++){
+    int32_t *block = pool.createArray<int32_t>(2);
+    aligned = aligned && block!=nullptr && ((uintptr_t)block % alignof(max_align_t))==0;
+  }
+  check(aligned, "pool alignment");
+
+  // single characters are processed with the bulk operations
+  RingBufferStream chars(10);
+  AudioStream &audio = chars;
+  audio.write('a');
+  check(audio.available()==1 && audio.read()=='a' && audio.read()==-1, "single characters");
+
+  // the capacity is the requested size: also for the lock free (mirrored) buffer
+  check(chars.size()==10 && chars.availableForWrite()==10, "ring buffer size");
+  RingBufferStream mirrored(10, true);
+  check(mirrored.availableForWrite()==10 && mirrored.write(input, sizeof(input))==10, "mirrored size");
+
+  Serial.print("copy of ");
+  Serial.print((int)sizeof(input));
+  Serial.print(" bytes took ");
+  Serial.print((int)ms);
+  Serial.print(" ms with ");
+  Serial.print(full_count);
+  Serial.println(" calls on a full output");
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
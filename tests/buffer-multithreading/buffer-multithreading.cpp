@@ -0,0 +1,104 @@
+// Stress test for the lock free buffers: a producer thread is writing a sequence of numbers which 
+// is verified by the consumer thread. We use both the single value and the array api. 
+#include "Arduino.h"
+#include "AudioTools.h"
+#include <thread>
+
+using namespace audio_tools;  
+
+const int buffer_size = 1000;
+const uint32_t total = 10000000;
+
+// writes an increasing sequence of numbers with varying block sizes
+void producer(BaseBuffer<uint32_t> *buffer) {
+    uint32_t data[128];
+    uint32_t next = 0;
+    int block = 1;
+    while (next < total){
+        int len = min(block, (int)(total - next));
+        for (int j=0;j<len;j++){
+            data[j] = next + j;
+        }
+        int written = len == 1 ? buffer->write(data[0]) : buffer->writeArray(data, len);
+        next += written;
+        // buffer is full: give the consumer a chance
+        if (written==0) std::this_thread::yield();
+        block = block % 127 + 1;
+    }
+}
+
+// reads and verifies the sequence - returns the number of errors
+void consumer(BaseBuffer<uint32_t> *buffer, uint32_t &errors) {
+    uint32_t data[128];
+    uint32_t expected = 0;
+    int block = 1;
+    while (expected < total){
+        int len = 0;
+        if (block == 1){
+            if (buffer->available()>0){
+                data[0] = buffer->read();
+                len = 1;
+            }
+        } else {
+            len = buffer->readArray(data, block);
+        }
+        // buffer is empty: give the producer a chance
+        if (len==0) std::this_thread::yield();
+        for (int j=0;j<len;j++){
+            if (data[j]!=expected){
+                errors++;
+            }
+            expected++;
+        }
+        block = block % 113 + 1;
+    }
+}
+
+// runs the producer and consumer in separate threads 
+void test(const char* name, BaseBuffer<uint32_t> &buffer){
+  uint32_t errors = 0;
+  unsigned long start = millis();
+  std::thread consumer_thread(consumer, &buffer, std::ref(errors));
+  std::thread producer_thread(producer, &buffer);
+  producer_thread.join();
+  consumer_thread.join();
+
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print((long)total);
+  Serial.print(" values in ");
+  Serial.print(millis()-start);
+  Serial.print(" ms with errors: ");
+  Serial.println((long)errors);
+  if (errors>0 || buffer.available()!=0){
+      exit(1);
+  }
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+}
+
+void loop(){
+  AtomicRingBuffer<uint32_t> ring_buffer(buffer_size);
+  test("AtomicRingBuffer", ring_buffer);
+
+  static RingBufferT<uint32_t, 1024> ring_buffer_t;
+  test("RingBufferT", ring_buffer_t);
+
+#ifdef USE_MIRRORED_BUFFER
+  MirroredRingBuffer<uint32_t> mirrored_buffer(buffer_size);
+  test("MirroredRingBuffer", mirrored_buffer);
+#endif
+
+  // only full buffers can be read: the total must be a multiple of the buffer size
+  NBuffer<uint32_t> n_buffer(100, 10);
+  test("NBuffer", n_buffer);
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,77 @@
+// Compares the bulk readArray/writeArray of the RingBuffer, RingBufferT, SingleBuffer and MirroredRingBuffer with the 
+// generic per element implementation of the BaseBuffer
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;  
+
+const int buffer_size = A2DP_BUFFER_SIZE*A2DP_BUFFER_COUNT;
+const int block_size = 1000; // not a divider of buffer_size, so that we test the wrap around
+const long total_bytes = 100l * 1024l * 1024l;
+uint8_t data[block_size];
+
+// measures the bytes per second which pass through the buffer
+template <class B>
+double measure(B &buffer, bool bulk){
+    buffer.reset();
+    long count = 0;
+    unsigned long start = micros();
+    while (count < total_bytes){
+        int written = bulk ? buffer.writeArray(data, block_size) : buffer.BaseBuffer<uint8_t>::writeArray(data, block_size);
+        int read = bulk ? buffer.readArray(data, written) : buffer.BaseBuffer<uint8_t>::readArray(data, written);
+        if (read!=written){
+            LOGE("Invalid result: %d -> %d", written, read);
+            stop();
+        }
+        count += read;
+        // the SingleBuffer can only be reused after a reset
+        if (written==0){
+            buffer.reset();
+        }
+    }
+    unsigned long time_us = micros() - start;
+    return time_us == 0 ? 0.0 : 1000000.0 * count / time_us;
+}
+
+template <class B>
+void report(const char* name, B &buffer){
+    double per_element = measure(buffer, false);
+    double bulk = measure(buffer, true);
+    Serial.print(name);
+    Serial.print(": per element ");
+    Serial.print(per_element / 1000000.0);
+    Serial.print(" MB/s - bulk ");
+    Serial.print(bulk / 1000000.0);
+    Serial.print(" MB/s - factor ");
+    Serial.println(per_element==0.0 ? 0.0 : bulk / per_element);
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+  for (int j=0;j<block_size;j++){
+      data[j] = j;
+  }
+}
+
+void loop(){
+  RingBuffer<uint8_t> ring_buffer(buffer_size);
+  report("RingBuffer", ring_buffer);
+
+  static RingBufferT<uint8_t, nextPowerOf2(buffer_size)> ring_buffer_t;
+  report("RingBufferT", ring_buffer_t);
+
+  SingleBuffer<uint8_t> single_buffer(buffer_size);
+  report("SingleBuffer", single_buffer);
+
+#ifdef USE_MIRRORED_BUFFER
+  MirroredRingBuffer<uint8_t> mirrored_buffer(buffer_size);
+  report("MirroredRingBuffer", mirrored_buffer);
+#endif
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
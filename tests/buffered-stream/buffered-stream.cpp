@@ -0,0 +1,80 @@
+// Tests the BufferedStream with an output which accepts only a part of each write: no data must be lost
+// and the blocks which are passed on must end at a frame boundary
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+// accepts only max_len bytes per call
+class LimitedBufferedStream : public BufferedStream {
+    public:
+        LimitedBufferedStream(size_t bufferSize, size_t size, size_t maxLen) : BufferedStream(bufferSize), data(size) {
+            max_len = maxLen;
+        }
+        MemoryStream data;
+        size_t max_len;
+        size_t total = 0;
+        bool aligned = true;
+
+    protected:
+        size_t writeExt(const uint8_t* buffer, size_t len) {
+            // the requested blocks must complete the frames
+            aligned = aligned && (total + len) % 4 == 0;
+            size_t result = data.write(buffer, MIN(len, max_len));
+            total += result;
+            return result;
+        }
+        size_t readExt(uint8_t *buffer, size_t len) {
+            return 0;
+        }
+};
+
+void test(size_t maxLen, size_t writeLen) {
+    const int n = 10000;
+    uint8_t in[n];
+    for (int j=0;j<n;j++){
+        in[j] = rand();
+    }
+    LimitedBufferedStream out(64, n, maxLen);
+    out.setFrameSize(4);
+    size_t pos = 0;
+    int retries = 0;
+    while (pos < n && retries < 100000){
+        pos += out.write(in + pos, MIN(writeLen, n - pos));
+        retries++;
+    }
+    // the last incomplete frame stays in the buffer
+    for (int j=0;j<1000;j++){
+        out.flush();
+    }
+    uint8_t result[n];
+    size_t len = out.data.readBytes(result, n);
+    char msg[80];
+    sprintf(msg, "max %d / write %d", (int) maxLen, (int) writeLen);
+    check(pos==n && len==n && memcmp(in, result, n)==0, msg);
+    check(out.aligned, "frames");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+}
+
+void loop(){
+  test(5, 7);
+  test(5, 200);
+  test(30, 3);
+  test(100, 1000);
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
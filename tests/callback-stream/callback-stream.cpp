@@ -0,0 +1,100 @@
+// Tests the CallbackStream: zero copy exchange of whole buffers, the Stream api and the underrun modes
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;  
+
+const int buffer_size = 256;
+const int buffer_count = 4;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+// producer fills the buffers in place and the consumer processes them in place
+void testZeroCopy() {
+    CallbackStream<int16_t> stream(buffer_size, buffer_count);
+    stream.begin();
+    int16_t next_write = 0;
+    int16_t next_read = 0;
+    bool ok = true;
+    for (int loop=0; loop<100 && ok; loop++){
+        // fill all free buffers
+        BufferSpan<int16_t> span = stream.getWriteBuffer();
+        while (span){
+            for (int j=0;j<span.size;j++){
+                span.data[j] = next_write++;
+            }
+            stream.commit(span.size);
+            span = stream.getWriteBuffer();
+        }
+        // consume one buffer
+        span = stream.getReadBuffer();
+        ok = span.size == buffer_size;
+        for (int j=0;j<span.size && ok;j++){
+            ok = span.data[j] == next_read++;
+        }
+        stream.release(span.size);
+    }
+    check(ok, "zero copy");
+}
+
+// the stream api is using bytes
+void testStream() {
+    CallbackStream<int16_t> stream(buffer_size, buffer_count);
+    stream.begin();
+    int16_t data[buffer_size * 2];
+    for (int j=0;j<buffer_size*2;j++){
+        data[j] = j;
+    }
+    check(stream.write((uint8_t*)data, sizeof(data))==sizeof(data), "write");
+    int16_t result[buffer_size * 2];
+    size_t len = stream.readBytes((uint8_t*)result, sizeof(result));
+    check(len==sizeof(result) && memcmp(data, result, sizeof(result))==0, "readBytes");
+}
+
+// we provide 1 buffer and read 2
+void testUnderrun(UnderrunMode mode, const char* name) {
+    CallbackStream<int16_t> stream(buffer_size, buffer_count, mode, 2);
+    stream.begin();
+    BufferSpan<int16_t> span = stream.getWriteBuffer();
+    for (int j=0;j<span.size;j++){
+        span.data[j] = j+1;
+    }
+    stream.commit(span.size);
+
+    int16_t result[buffer_size * 2];
+    size_t len = stream.readSamples(result, buffer_size * 2);
+    bool ok = len == buffer_size * 2 && stream.underruns()==1;
+    for (int j=0;j<buffer_size && ok;j++){
+        int16_t expected = 0;
+        switch(mode){
+            case UNDERRUN_SILENCE: expected = 0; break;
+            case UNDERRUN_REPEAT: expected = j+1; break;
+            case UNDERRUN_HOLD: expected = buffer_size - 1 + (j % 2); break;
+        }
+        ok = result[j]==j+1 && result[buffer_size+j]==expected;
+    }
+    check(ok, name);
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+}
+
+void loop(){
+  testZeroCopy();
+  testStream();
+  testUnderrun(UNDERRUN_SILENCE, "underrun silence");
+  testUnderrun(UNDERRUN_REPEAT, "underrun repeat");
+  testUnderrun(UNDERRUN_HOLD, "underrun hold");
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
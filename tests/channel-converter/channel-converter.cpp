@@ -0,0 +1,111 @@
+// Applies converters to mono, 3 and 4 channel data in interleaved and planar layout: the stereo converters
+// are processed in channel pairs. We also copy 4 channel data with a converter with the StreamCopy.
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;
+
+const int frames = 100;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+// value which identifies the frame and channel
+int16_t value(int frame, int channel){
+    return frame * 10 + channel;
+}
+
+void setupData(int16_t *data, int channels, ChannelLayout layout){
+    for (int j=0;j<frames;j++){
+        for (int ch=0;ch<channels;ch++){
+            int idx = layout==CHANNELS_INTERLEAVED ? j * channels + ch : ch * frames + j;
+            data[idx] = value(j, ch);
+        }
+    }
+}
+
+// checks that each channel contains the data of the expected channel (multiplied with factor)
+bool isExpected(int16_t *data, int channels, ChannelLayout layout, const int *source, int factor=1){
+    for (int j=0;j<frames;j++){
+        for (int ch=0;ch<channels;ch++){
+            int idx = layout==CHANNELS_INTERLEAVED ? j * channels + ch : ch * frames + j;
+            if (data[idx] != value(j, source[ch]) * factor) return false;
+        }
+    }
+    return true;
+}
+
+void testLayouts(ChannelLayout layout, const char* msg) {
+    int16_t data[frames * 4];
+    const int same[] = {0, 1, 2, 3};
+    const int swapped[] = {1, 0, 3, 2};
+    const int odd[] = {1, 0, 2};
+
+    ConverterScaler<int16_t> scaler(2.0, 0, 32767);
+    setupData(data, 4, layout);
+    scaler.convertBlock(data, frames, 4, layout);
+    bool ok = isExpected(data, 4, layout, same, 2);
+
+    ConverterSwitchLeftAndRight<int16_t> swap;
+    setupData(data, 4, layout);
+    swap.convertBlock(data, frames, 4, layout);
+    ok = ok && isExpected(data, 4, layout, swapped);
+
+    // the last channel is processed as left and right
+    setupData(data, 3, layout);
+    swap.convertBlock(data, frames, 3, layout);
+    ok = ok && isExpected(data, 3, layout, odd);
+
+    setupData(data, 1, layout);
+    swap.convertBlock(data, frames, 1, layout);
+    ok = ok && isExpected(data, 1, layout, same);
+    check(ok, msg);
+}
+
+void testStereo() {
+    int16_t data[frames][2];
+    int16_t expected[frames][2];
+    setupData((int16_t*)data, 2, CHANNELS_INTERLEAVED);
+    setupData((int16_t*)expected, 2, CHANNELS_INTERLEAVED);
+    ConverterScaler<int16_t> scaler(0.5, 10, 32767);
+    scaler.convertBlock((int16_t*)data, frames, 2);
+    scaler.convert(expected, frames);
+    check(memcmp(data, expected, sizeof(data))==0, "stereo");
+}
+
+void testCopy() {
+    int16_t data[frames * 4];
+    const int same[] = {0, 1, 2, 3};
+    setupData(data, 4, CHANNELS_INTERLEAVED);
+    MemoryStream in((uint8_t*)data, sizeof(data));
+    MemoryStream out(sizeof(data));
+    ConverterScaler<int16_t> scaler(2.0, 0, 32767);
+    // the buffer size is not a multiple of the frame size
+    StreamCopy copier(out, in, 100);
+    while (in.available()>0){
+        copier.copy(scaler, 4);
+    }
+    int16_t result[frames * 4];
+    check(out.readBytes((uint8_t*)result, sizeof(result))==sizeof(result) && isExpected(result, 4, CHANNELS_INTERLEAVED, same, 2), "copy 4 channels");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+}
+
+void loop(){
+  testLayouts(CHANNELS_INTERLEAVED, "interleaved");
+  testLayouts(CHANNELS_PLANAR, "planar");
+  testStereo();
+  testCopy();
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,141 @@
+// Tests the ConverterChain: the fused processing must provide the same result as the MultiConverter which
+// applies one converter after the other to the whole block. We also compare the speed of both on 1M stereo frames
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;
+
+const size_t frames = 1000000;
+const size_t block = 256;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+// positive offset on the left channel, silent right channel
+void fillData(int16_t (*data)[2], size_t size){
+    for (size_t j=0;j<size;j++){
+        data[j][0] = 1000 + (rand() % 20000) - 10000;
+        data[j][1] = 0;
+    }
+}
+
+void processBlocks(BaseConverter<int16_t> &converter, int16_t (*data)[2], size_t size){
+    for (size_t j=0;j<size;j+=block){
+        converter.convert(data+j, MIN(block, size-j));
+    }
+}
+
+// returns true if the fused chain was faster than the multi converter
+bool testChain(int16_t (*data)[2], int16_t (*expected)[2], size_t size) {
+    fillData(data, size);
+    memcpy(expected, data, size * sizeof(int16_t) * 2);
+    unsigned long start;
+
+    ConverterAutoCenter<int16_t> center1;
+    ConverterScaler<int16_t> scaler1(0.8, 0, 32000);
+    ConverterFillLeftAndRight<int16_t> fill1;
+    ConverterToInternalDACFormat<int16_t> dac1;
+    MultiConverter<int16_t> multi;
+    multi.add(fill1);
+    multi.add(center1);
+    multi.add(scaler1);
+    multi.add(dac1);
+    start = micros();
+    processBlocks(multi, expected, size);
+    unsigned long us_multi = micros() - start;
+
+    ConverterAutoCenter<int16_t> center2;
+    ConverterScaler<int16_t> scaler2(0.8, 0, 32000);
+    ConverterFillLeftAndRight<int16_t> fill2;
+    ConverterToInternalDACFormat<int16_t> dac2;
+    auto chain = converterChain<int16_t>(fill2, center2, scaler2, dac2);
+    start = micros();
+    processBlocks(chain, data, size);
+    unsigned long us_chain = micros() - start;
+
+    check(memcmp(data, expected, size * sizeof(int16_t) * 2)==0, "chain == multi converter");
+    check(data[0][0]==data[0][1] && data[size-1][0]==data[size-1][1], "filled");
+
+    // the chain is set up now: all converters are applied in a single pass
+    fillData(data, size);
+    memcpy(expected, data, size * sizeof(int16_t) * 2);
+    start = micros();
+    processBlocks(chain, data, size);
+    unsigned long us_fused = micros() - start;
+    start = micros();
+    processBlocks(multi, expected, size);
+    unsigned long us_passes = micros() - start;
+    check(memcmp(data, expected, size * sizeof(int16_t) * 2)==0, "fused == multi converter");
+
+    Serial.print("chain: ");
+    Serial.print(us_chain);
+    Serial.print(" us - multi converter: ");
+    Serial.print(us_multi);
+    Serial.print(" us - fused: ");
+    Serial.print(us_fused);
+    Serial.print(" us - multi converter: ");
+    Serial.print(us_passes);
+    Serial.println(" us");
+    return us_fused < us_passes;
+}
+
+void testFloat() {
+    float data[2][2] = {{0.5, -0.25}, {0.25, 0.0}};
+    ConverterSwitchLeftAndRight<float> swap;
+    ConverterScaler<float> scaler(2.0, 0.0, 0.75);
+    ConverterChain<float, ConverterSwitchLeftAndRight<float>, ConverterScaler<float>> chain(swap, scaler);
+    chain.convert(data, 2);
+    check(data[0][0]==-0.5 && data[0][1]==0.75 && data[1][0]==0.0 && data[1][1]==0.5, "float chain");
+
+    // planar 3 channels via the default convertBlock
+    int16_t planar[3][2] = {{1, 2}, {3, 4}, {5, 6}};
+    ConverterScaler<int16_t> doubler(2.0, 0, 32767);
+    ConverterChain<int16_t, ConverterScaler<int16_t>> single(doubler);
+    single.convertBlock((int16_t*)planar, 2, 3, CHANNELS_PLANAR);
+    check(planar[0][0]==2 && planar[1][1]==8 && planar[2][1]==12, "convertBlock");
+}
+
+void testInt32() {
+    // without vector kernels the fused chain processes frame by frame
+    int32_t data[3][2] = {{1000, -2000}, {70000, 0}, {-5, 5}};
+    int32_t expected[3][2];
+    memcpy(expected, data, sizeof(data));
+    ConverterSwitchLeftAndRight<int32_t> swap1, swap2;
+    ConverterScaler<int32_t> scaler1(1.5, 10, 100000), scaler2(1.5, 10, 100000);
+    MultiConverter<int32_t> multi;
+    multi.add(swap1);
+    multi.add(scaler1);
+    multi.convert(expected, 3);
+    auto chain = converterChain<int32_t>(swap2, scaler2);
+    chain.convert(data, 3);
+    check(memcmp(data, expected, sizeof(data))==0 && data[1][1]==100000, "int32 chain");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+}
+
+void loop(){
+  int16_t (*data)[2] = new int16_t[frames][2];
+  int16_t (*expected)[2] = new int16_t[frames][2];
+  testChain(data, expected, 1001);
+  bool faster = testChain(data, expected, frames);
+#ifdef __OPTIMIZE__
+  // w/o optimization the kernels are not inlined
+  check(faster, "fused chain faster than multi converter");
+#endif
+  testInt32();
+  testFloat();
+  delete[] data;
+  delete[] expected;
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
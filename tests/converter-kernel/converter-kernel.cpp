@@ -0,0 +1,224 @@
+// Tests the ConverterKernel: we compare the optimized implementation with the scalar implementation, check
+// the converters and measure the converters against the previous float/scalar loops on 1M stereo frames
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;
+
+const size_t frames = 1000000;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+template <typename T>
+void fillRandom(T *data, size_t samples){
+    for (size_t j=0;j<samples;j++){
+        data[j] = rand();
+    }
+}
+
+// we use an odd number of samples and an unaligned start to cover the scalar tail
+template <typename T>
+void testKernel(const char* name) {
+    const int n = 1001;
+    T data[n+1];
+    T expected[n+1];
+    int16_t gain;
+    int shift;
+
+    bool ok = true;
+    const float factors[] = {0.7f, 0.0001f, 3.5f, -1.25f};
+    for (int k=0;k<4;k++){
+        ConverterKernel::toFixedPoint(factors[k], gain, shift);
+        fillRandom(data, n+1);
+        memcpy(expected, data, sizeof(data));
+        ConverterKernel::scale(data+1, n, (T)100, gain, shift, (T)20000);
+        ConverterKernel::scaleScalar(expected+1, n, (T)100, gain, shift, (T)20000);
+        ok = ok && memcmp(data, expected, sizeof(data))==0;
+    }
+
+    fillRandom(data, n+1);
+    memcpy(expected, data, sizeof(data));
+    ConverterKernel::add(data+1, n, (T)-30000);
+    ConverterKernel::addScalar(expected+1, n, (T)-30000);
+    ok = ok && memcmp(data, expected, sizeof(data))==0;
+
+    fillRandom(data, n+1);
+    memcpy(expected, data, sizeof(data));
+    ConverterKernel::swap(data+1, n/2);
+    ConverterKernel::swapScalar(expected+1, n/2);
+    ok = ok && memcmp(data, expected, sizeof(data))==0;
+
+    for (int channel=0;channel<2;channel++){
+        fillRandom(data, n+1);
+        memcpy(expected, data, sizeof(data));
+        ConverterKernel::fill(data+1, n/2, channel);
+        ConverterKernel::fillScalar(expected+1, n/2, channel);
+        ok = ok && memcmp(data, expected, sizeof(data))==0;
+    }
+    check(ok, name);
+}
+
+void testUnsigned() {
+    const int n = 1001;
+    int16_t data[n];
+    int16_t expected[n];
+    fillRandom(data, n);
+    memcpy(expected, data, sizeof(data));
+    ConverterKernel::toUnsigned(data, n);
+    ConverterKernel::toUnsignedScalar(expected, n);
+    check(memcmp(data, expected, sizeof(data))==0, "unsigned kernel == scalar");
+    int16_t value[2] = {-32768, 0};
+    ConverterKernel::toUnsigned(value, 2);
+    check((uint16_t)value[0]==0 && (uint16_t)value[1]==0x8000, "unsigned");
+}
+
+void testConverters() {
+    int16_t data[3][2] = {{1000, -1000}, {30000, -30000}, {-5, 7}};
+    ConverterScaler<int16_t> scaler(2.0, 10, 32000);
+    scaler.convert(data, 3);
+    check(data[0][0]==2020 && data[0][1]==-1980 && data[1][0]==32000 && data[1][1]==-32000, "scaler");
+
+    ConverterSwitchLeftAndRight<int16_t> swap;
+    swap.convert(data, 3);
+    check(data[0][0]==-1980 && data[0][1]==2020 && data[2][0]==34 && data[2][1]==10, "switch left and right");
+
+    ConverterFillLeftAndRight<int16_t> fill(RightIsEmpty);
+    fill.convert(data, 3);
+    check(data[0][1]==-1980 && data[2][1]==34, "fill left and right");
+
+    // big and small factors must not be limited by the fixed point representation
+    int32_t values32[1][2] = {{1000, -1000}};
+    ConverterScaler<int32_t> scaler32(65536.0, 0, INT32_MAX);
+    scaler32.convert(values32, 1);
+    check(values32[0][0]==65536000 && values32[0][1]==-65536000, "int32 scaler x65536");
+
+    int32_t small32[1][2] = {{2000000000, -2000000000}};
+    ConverterScaler<int32_t> scaler_small32(0.00002, 0, INT32_MAX);
+    scaler_small32.convert(small32, 1);
+    check(abs(small32[0][0] - 40000) <= 1 && abs(small32[0][1] + 40000) <= 1, "int32 scaler x0.00002");
+
+    int16_t small[2][2] = {{30000, -30000}, {30000, -30000}};
+    ConverterScaler<int16_t> scaler_small(0.0001, 0, 32767);
+    scaler_small.convert(small, 1);
+    ConverterScaler<int16_t> scaler_smaller(0.00002, 0, 32767);
+    scaler_smaller.convert(small+1, 1);
+    check(small[0][0]==3 && small[0][1]==-3 && small[1][0]==1 && small[1][1]==-1, "int16 scaler small factors");
+
+    float values[1][2] = {{0.5, -0.25}};
+    ConverterScaler<float> float_scaler(2.0, 0.0, 0.75);
+    float_scaler.convert(values, 1);
+    check(values[0][0]==0.75 && values[0][1]==-0.5, "float scaler");
+}
+
+// previous implementation of the ConverterScaler
+void scaleLegacy(int16_t (*src)[2], size_t size, float factor, int16_t offset, int16_t maxValue){
+    for (size_t j=0;j<size;j++){
+        src[j][0] = (src[j][0] + offset) * factor;
+        if (src[j][0]>maxValue){
+            src[j][0] = maxValue;
+        } else if (src[j][0]<-maxValue){
+            src[j][0] = -maxValue;
+        }
+        src[j][1] = src[j][1] + offset * factor;
+        if (src[j][1]>maxValue){
+            src[j][1] = maxValue;
+        } else if (src[j][0]<-maxValue){
+            src[j][1] = -maxValue;
+        }
+    }
+}
+
+// previous implementation of the ConverterToInternalDACFormat
+void toUnsignedLegacy(int16_t (*src)[2], size_t size){
+    for (size_t i=0; i<size; i++) {
+        src[i][0] = src[i][0] + 0x8000;
+        src[i][1] = src[i][1] + 0x8000;
+    }
+}
+
+// previous implementation of the ConverterAutoCenter
+void centerLegacy(int16_t (*src)[2], size_t size, int16_t offset){
+    for (size_t j=0; j<size; j++){
+        src[j][0] = src[j][0] - offset;
+        src[j][1] = src[j][1] - offset;
+    }
+}
+
+// previous implementation of the ConverterFillLeftAndRight
+void fillLegacy(int16_t (*src)[2], size_t size){
+    for (size_t j=0;j<size;j++){
+        src[j][1] = src[j][0];
+    }
+}
+
+void printResult(const char* name, unsigned long us, unsigned long us_legacy){
+    Serial.print(name);
+    Serial.print(": ");
+    Serial.print(us);
+    Serial.print(" us - previous: ");
+    Serial.print(us_legacy);
+    Serial.println(" us");
+}
+
+void benchmark() {
+    int16_t (*data)[2] = new int16_t[frames][2];
+    fillRandom((int16_t*)data, frames*2);
+    unsigned long start;
+    unsigned long us;
+
+    ConverterScaler<int16_t> scaler(0.8, 0, 32767);
+    start = micros();
+    scaler.convert(data, frames);
+    us = micros() - start;
+    start = micros();
+    scaleLegacy(data, frames, 0.8, 0, 32767);
+    printResult("scaler", us, micros() - start);
+
+    ConverterToInternalDACFormat<int16_t> dac;
+    start = micros();
+    dac.convert(data, frames);
+    us = micros() - start;
+    start = micros();
+    toUnsignedLegacy(data, frames);
+    printResult("dac format", us, micros() - start);
+
+    start = micros();
+    ConverterKernel::add((int16_t*)data, frames*2, -100);
+    us = micros() - start;
+    start = micros();
+    centerLegacy(data, frames, 100);
+    printResult("auto center", us, micros() - start);
+
+    ConverterFillLeftAndRight<int16_t> fill(RightIsEmpty);
+    start = micros();
+    fill.convert(data, frames);
+    us = micros() - start;
+    start = micros();
+    fillLegacy(data, frames);
+    printResult("fill left and right", us, micros() - start);
+
+    delete[] data;
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+}
+
+void loop(){
+  testKernel<int16_t>("int16_t kernel == scalar");
+  testKernel<int32_t>("int32_t kernel == scalar");
+  testUnsigned();
+  testConverters();
+  benchmark();
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
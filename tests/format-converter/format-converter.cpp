@@ -0,0 +1,219 @@
+// Tests the FormatConverter: we check the conversion of individual values, the round trip between the formats,
+// the write and read mode with incomplete samples and compare the speed with the previous float conversion
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;
+
+const size_t samples = 1000000;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+// Output which accepts only max_len bytes per call
+class LimitedOutput : public Print {
+    public:
+        LimitedOutput(size_t size, size_t maxLen) : data(size) {
+            max_len = maxLen;
+        }
+        size_t write(uint8_t c) { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t len) {
+            return data.write(buffer, MIN(len, max_len));
+        }
+        MemoryStream data;
+        size_t max_len;
+};
+
+void testValues() {
+    int16_t in16[] = {0x1234, -32768, 16384, 32767};
+    uint8_t packed[12];
+    FormatKernels::convert(FORMAT_S16, FORMAT_S24_PACKED, (uint8_t*)in16, packed, 4);
+    check(packed[0]==0 && packed[1]==0x34 && packed[2]==0x12 && packed[5]==0x80, "16 -> 24 packed");
+
+    float floats[4];
+    FormatKernels::convert(FORMAT_S16, FORMAT_FLOAT, (uint8_t*)in16, (uint8_t*)floats, 4);
+    check(floats[1]==-1.0 && floats[2]==0.5, "16 -> float");
+
+    float clipped[] = {1.0, -1.0, 2.0, -0.25};
+    int16_t out16[4];
+    FormatKernels::convert(FORMAT_FLOAT, FORMAT_S16, (uint8_t*)clipped, (uint8_t*)out16, 4);
+    check(out16[0]==32767 && out16[1]==-32768 && out16[2]==32767 && out16[3]==-8192, "float -> 16");
+
+    uint8_t u8[] = {0, 128, 255};
+    FormatKernels::convert(FORMAT_U8, FORMAT_S16, u8, (uint8_t*)out16, 3);
+    check(out16[0]==-32768 && out16[1]==0 && out16[2]==32512, "8u -> 16");
+
+    int32_t in24[] = {8388607, -8388608, -1};
+    FormatKernels::convert(FORMAT_S24_IN_32, FORMAT_S16, (uint8_t*)in24, (uint8_t*)out16, 3);
+    check(out16[0]==32767 && out16[1]==-32768 && out16[2]==-1, "24 in 32 -> 16");
+
+    int24_t value(in24 + 1);
+    check(value.scale16()==-32768 && value.scale32()==INT32_MIN && value.scaleFloat()==-8388608.0f/8388607.0f, "int24_t");
+    check(maxValue(8)==127 && maxValue(24)==8388607 && maxValue(32)==2147483647, "maxValue");
+}
+
+// 16 bit values must survive a round trip through all formats which have at least 16 bits
+void testRoundTrip() {
+    const SampleFormat formats[] = {FORMAT_S16, FORMAT_S24_PACKED, FORMAT_S24_IN_32, FORMAT_S32, FORMAT_FLOAT};
+    const int n = 1000;
+    int16_t in[n];
+    int16_t out[n];
+    uint8_t tmp[n * 4];
+    bool ok = true;
+    for (int j=0;j<n;j++){
+        in[j] = rand();
+    }
+    for (int j=0;j<5;j++){
+        FormatKernels::convert(FORMAT_S16, formats[j], (uint8_t*)in, tmp, n);
+        FormatKernels::convert(formats[j], FORMAT_S16, tmp, (uint8_t*)out, n);
+        ok = ok && memcmp(in, out, sizeof(in))==0;
+    }
+
+    uint8_t in8[256];
+    uint8_t out8[256];
+    for (int j=0;j<256;j++){
+        in8[j] = j;
+    }
+    for (int j=0;j<5;j++){
+        FormatKernels::convert(FORMAT_U8, formats[j], in8, tmp, 256);
+        FormatKernels::convert(formats[j], FORMAT_U8, tmp, out8, 256);
+        ok = ok && memcmp(in8, out8, sizeof(in8))==0;
+    }
+    check(ok, "round trip");
+}
+
+void testStream() {
+    const int n = 999;
+    uint8_t in[n * 3];
+    int16_t expected[n];
+    for (int j=0;j<n*3;j++){
+        in[j] = rand();
+    }
+    FormatKernels::convert(FORMAT_S24_PACKED, FORMAT_S16, in, (uint8_t*)expected, n);
+
+    // write mode: odd write sizes and an output which accepts only some bytes
+    LimitedOutput out(sizeof(expected), 5);
+    FormatConverter writer(out, FORMAT_S24_PACKED, FORMAT_S16, 64);
+    size_t pos = 0;
+    while (pos < sizeof(in)){
+        pos += writer.write(in + pos, MIN((size_t)7, sizeof(in) - pos));
+    }
+    while (writer.availableForWrite()==0){
+        writer.flush();
+    }
+    int16_t result[n];
+    check(out.data.readBytes((uint8_t*)result, sizeof(result))==sizeof(result) && memcmp(result, expected, sizeof(result))==0, "write");
+
+    // read mode: odd read sizes
+    MemoryStream data(in, sizeof(in));
+    FormatConverter reader(data, FORMAT_S24_PACKED, FORMAT_S16, 64);
+    check(reader.available()==(int)sizeof(expected), "available");
+    pos = 0;
+    while (reader.available()>0){
+        pos += reader.readBytes((uint8_t*)result + pos, MIN((size_t)11, sizeof(result) - pos));
+    }
+    check(pos==sizeof(result) && memcmp(result, expected, sizeof(result))==0, "read");
+}
+
+// previous conversions via float
+void convert32To16Float(int32_t *in, int16_t *out, size_t n){
+    for (size_t j=0;j<n;j++){
+        out[j] = static_cast<float>(in[j]) / INT32_MAX * INT16_MAX;
+    }
+}
+
+void convert24To16Float(int24_t *in, int16_t *out, size_t n){
+    for (size_t j=0;j<n;j++){
+        out[j] = static_cast<float>(static_cast<int32_t>(in[j])) * INT16_MAX / INT24_MAX;
+    }
+}
+
+void convert16To32Float(int16_t *in, int32_t *out, size_t n){
+    for (size_t j=0;j<n;j++){
+        out[j] = static_cast<float>(in[j]) / maxValue(16) * maxValue(32);
+    }
+}
+
+void printResult(const char* name, unsigned long us, unsigned long us_float){
+    Serial.print(name);
+    Serial.print(": ");
+    Serial.print(us);
+    Serial.print(" us - float: ");
+    Serial.print(us_float);
+    Serial.print(" us - factor: ");
+    Serial.print(us == 0 ? 0.0 : (float) us_float / us, 1);
+    Serial.println();
+}
+
+void benchmark() {
+    int32_t *in32 = new int32_t[samples];
+    int16_t *out16 = new int16_t[samples];
+    int24_t *in24 = new int24_t[samples];
+    for (size_t j=0;j<samples;j++){
+        in32[j] = rand() - RAND_MAX / 2;
+        in24[j] = int24_t((int32_t)(rand() & 0x7FFFFF));
+        out16[j] = 0;
+    }
+    unsigned long start, us, us_float;
+    unsigned long total = 0, total_float = 0;
+    // warmup: the memory should be mapped before we measure
+    convert32To16Float(in32, out16, samples);
+    convert16To32Float(out16, in32, samples);
+
+    start = micros();
+    FormatKernels::convert(FORMAT_S32, FORMAT_S16, (uint8_t*)in32, (uint8_t*)out16, samples);
+    us = micros() - start;
+    start = micros();
+    convert32To16Float(in32, out16, samples);
+    us_float = micros() - start;
+    printResult("32 -> 16", us, us_float);
+    total += us; total_float += us_float;
+
+    start = micros();
+    FormatKernels::convert(FORMAT_S24_PACKED, FORMAT_S16, (uint8_t*)in24, (uint8_t*)out16, samples);
+    us = micros() - start;
+    start = micros();
+    convert24To16Float(in24, out16, samples);
+    us_float = micros() - start;
+    printResult("24 packed -> 16", us, us_float);
+    total += us; total_float += us_float;
+
+    start = micros();
+    FormatKernels::convert(FORMAT_S16, FORMAT_S32, (uint8_t*)out16, (uint8_t*)in32, samples);
+    us = micros() - start;
+    start = micros();
+    convert16To32Float(out16, in32, samples);
+    us_float = micros() - start;
+    printResult("16 -> 32", us, us_float);
+    total += us; total_float += us_float;
+
+    printResult("total", total, total_float);
+    // on the desktop the float loops are vectorized as well and the 16/32 bit conversions are limited by the
+    // memory bandwidth: the big difference is expected on microcontrollers w/o (double precision) FPU
+    check(total < total_float, "faster than float");
+
+    delete[] in32;
+    delete[] out16;
+    delete[] in24;
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+}
+
+void loop(){
+  testValues();
+  testRoundTrip();
+  testStream();
+  benchmark();
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
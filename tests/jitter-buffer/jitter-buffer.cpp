@@ -0,0 +1,153 @@
+// Simulates a bursty network source (e.g. WiFi latency spikes) which is written into a JitterBufferStream 
+// and a consumer which reads the data in real time: we verify that the data is not corrupted and report 
+// the underruns and the adapted target latency. We also check that the target latency grows after an underrun
+// and shrinks again when the data arrives in time.
+#include "Arduino.h"
+#include "AudioTools.h"
+#include <thread>
+
+using namespace audio_tools;  
+
+const int run_time_ms = 8000;
+const int chunk_ms = 20;     // network packet size
+const int read_ms = 10;      // consumer period
+volatile bool is_running = true;
+
+// sends the data in real time but stalls from time to time and then delivers the missing data as burst
+void producer(JitterBufferStream *stream, uint32_t bytes_per_second) {
+    uint8_t chunk[bytes_per_second * chunk_ms / 1000];
+    uint8_t next = 0;
+    unsigned long start = millis();
+    unsigned long sent_ms = 0;
+    srand(1);
+    while (is_running){
+        // simulate a latency spike every ~ second
+        if (rand() % 50 == 0){
+            delay(100 + rand() % 300);
+        }
+        // catch up with the real time
+        while (is_running && sent_ms < millis() - start){
+            for (size_t j=0;j<sizeof(chunk);j++){
+                chunk[j] = next++;
+            }
+            size_t written = 0;
+            while (is_running && written < sizeof(chunk)){
+                size_t result = stream->write(chunk + written, sizeof(chunk) - written);
+                written += result;
+                if (result==0) delay(1);
+            }
+            sent_ms += chunk_ms;
+        }
+        delay(chunk_ms);
+    }
+}
+
+// reads the data in real time and verifies the sequence
+void consumer(JitterBufferStream *stream, uint32_t bytes_per_second, uint32_t &errors) {
+    uint8_t data[bytes_per_second * read_ms / 1000];
+    uint8_t expected = 0;
+    unsigned long start = millis();
+    unsigned long next_time = start;
+    while (millis() - start < run_time_ms){
+        size_t len = min((size_t)stream->available(), sizeof(data));
+        len = stream->readBytes(data, len);
+        for (size_t j=0;j<len;j++){
+            if (data[j]!=expected){
+                errors++;
+                expected = data[j];
+            }
+            expected++;
+        }
+        next_time += read_ms;
+        long wait = next_time - millis();
+        if (wait>0) delay(wait);
+    }
+    is_running = false;
+}
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void testAdaption(JitterBufferConfig cfg) {
+    JitterBufferStream stream;
+    cfg.adapt_interval_ms = 100;
+    stream.begin(cfg);
+    uint8_t data[cfg.toBytes(1000)];
+    memset(data, 0, sizeof(data));
+
+    // pre-roll and then read everything: underrun
+    stream.write(data, cfg.toBytes(100));
+    stream.readBytes(data, stream.available());
+    // the reader detects the underrun
+    check(stream.available()==0 && !stream.isPlaying() && stream.stats().underruns==1, "underrun");
+    uint32_t target = stream.stats().target_latency_ms;
+    check(target > 100, "target grows after underrun");
+
+    // buffer the new target again and provide the data in time
+    stream.write(data, cfg.toBytes(target));
+    check(stream.available()>0 && stream.isPlaying(), "playing");
+    size_t chunk = cfg.toBytes(10);
+    bool written = true;
+    for (int j=0;j<100;j++){
+        delay(10);
+        written = written && stream.write(data, chunk)==chunk;
+        stream.readBytes(data, chunk);
+    }
+    check(written, "write");
+    JitterBufferStats stats = stream.stats();
+    check(stats.underruns==1 && stats.target_latency_ms < target, "target shrinks without underruns");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+}
+
+void loop(){
+  JitterBufferStream stream;
+  JitterBufferConfig cfg = stream.defaultConfig();
+  cfg.target_latency_ms = 100;
+  cfg.preroll_ms = 100;
+  // 8000 samples per second, mono, 16 bits
+  AudioBaseInfo info;
+  info.sample_rate = 8000;
+  info.channels = 1;
+  info.bits_per_sample = 16;
+  cfg.setAudioInfo(info);
+  testAdaption(cfg);
+  stream.begin(cfg);
+
+  uint32_t errors = 0;
+  std::thread consumer_thread(consumer, &stream, cfg.bytes_per_second, std::ref(errors));
+  std::thread producer_thread(producer, &stream, cfg.bytes_per_second);
+  consumer_thread.join();
+  producer_thread.join();
+
+  JitterBufferStats stats = stream.stats();
+  Serial.print("underruns: ");
+  Serial.print((long)stats.underruns);
+  Serial.print(" late writes: ");
+  Serial.print((long)stats.late_writes);
+  Serial.print(" late bytes: ");
+  Serial.print((long)stats.late_bytes);
+  Serial.print(" jitter: ");
+  Serial.print((long)stats.jitter_ms);
+  Serial.print(" ms target: ");
+  Serial.print((long)stats.target_latency_ms);
+  Serial.print(" ms latency: ");
+  Serial.print((long)stats.latency_ms);
+  Serial.print(" ms errors: ");
+  Serial.println((long)errors);
+  if (errors>0){
+      exit(1);
+  }
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,86 @@
+// Maps a mp3 file into the memory with MappedFileStream and uses the data w/o copying it: 
+// - with StreamCopy from the memory area 
+// - by writing the whole file to the MP3DecoderMini
+#include "Arduino.h"
+#include "AudioTools.h"
+#include "AudioCodecs/CodecMP3Mini.h"
+#include "../mp3-mini/BabyElephantWalk60_mp3.h"
+
+using namespace audio_tools;  
+
+const char* path = "/tmp/BabyElephantWalk60.mp3";
+
+// Output which just counts the bytes
+class CountingPrint : public Print {
+    public:
+        size_t write(uint8_t) { count++; return 1; }
+        size_t write(const uint8_t *data, size_t len) { count += len; return len; }
+        size_t count = 0;
+};
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+
+  // create the test file
+  FILE *f = fopen(path, "wb");
+  fwrite(BabyElephantWalk60_mp3, 1, BabyElephantWalk60_mp3_len, f);
+  fclose(f);
+}
+
+void loop(){
+  MappedFileStream file(path);
+  check(file && file.size()==BabyElephantWalk60_mp3_len, "mapping");
+  check(memcmp(file.data(), BabyElephantWalk60_mp3, file.size())==0, "content");
+
+  // copy from memory area
+  MemoryStream copy(1024, defaultAllocator(), true);
+  StreamCopy copier;
+  copier.begin(copy, file.data(), file.size());
+  while (copier.copy()>0);
+  uint8_t data[1024];
+  bool equal = copy.size() == file.size();
+  size_t pos = 0;
+  while (equal && copy.available()>0){
+      size_t len = copy.readBytes(data, sizeof(data));
+      equal = memcmp(data, file.data() + pos, len)==0;
+      pos += len;
+  }
+  check(equal, "StreamCopy from memory");
+
+  // read as stream
+  size_t total = 0;
+  while (file.available()>0){
+      total += file.readBytes(data, sizeof(data));
+  }
+  check(total==file.size(), "readBytes");
+
+  // decode the whole file w/o copying it
+  CountingPrint pcm;
+  MP3DecoderMini decoder;
+  decoder.setOutputStream(pcm);
+  decoder.begin();
+  unsigned long start = millis();
+  decoder.write(file.data(), file.size());
+  decoder.end();
+  Serial.print("decoded ");
+  Serial.print((long)pcm.count);
+  Serial.print(" bytes in ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+  check(pcm.count > 0, "decoding");
+
+  remove(path);
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
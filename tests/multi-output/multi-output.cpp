@@ -0,0 +1,78 @@
+// Writes the same data with a MultiOutput to a fast and to a slow output: we check that both receive all data
+// in the right sequence, that the fast output gets the data w/o copying and that the slow output is reported as bottleneck
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;  
+
+// Output which accepts only max_len bytes per call and records the data
+class LimitedOutput : public Print {
+    public:
+        LimitedOutput(size_t maxLen) : data(sizeof(input)) {
+            max_len = maxLen;
+        }
+        size_t write(uint8_t c) { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t len) { 
+            return data.write(buffer, MIN(len, max_len)); 
+        }
+        MemoryStream data;
+        size_t max_len;
+        static uint8_t input[100000];
+};
+uint8_t LimitedOutput::input[100000];
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+bool isEqual(MemoryStream &data){
+    uint8_t buffer[1000];
+    size_t pos = 0;
+    if (data.size()!=sizeof(LimitedOutput::input)) return false;
+    while(data.available()>0){
+        size_t len = data.readBytes(buffer, sizeof(buffer));
+        if (memcmp(buffer, LimitedOutput::input+pos, len)!=0) return false;
+        pos += len;
+    }
+    return true;
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+  for (size_t j=0;j<sizeof(LimitedOutput::input);j++){
+      LimitedOutput::input[j] = rand();
+  }
+}
+
+void loop(){
+  LimitedOutput fast(100000);
+  LimitedOutput slow(300);
+  MultiOutput out(fast, slow);
+
+  // write like StreamCopy: retry the data which was not accepted
+  size_t pos = 0;
+  while (pos < sizeof(LimitedOutput::input)){
+      pos += out.write(LimitedOutput::input+pos, MIN((size_t)1024, sizeof(LimitedOutput::input)-pos));
+  }
+  while(out.queued(1)>0){
+      out.flush();
+  }
+
+  check(isEqual(fast.data), "fast output");
+  check(isEqual(slow.data), "slow output");
+  check(out.stats(0).bytes_direct==sizeof(LimitedOutput::input), "fast output w/o copy");
+  check(out.bottleneck()==1, "bottleneck");
+  Serial.print("fast: ");
+  out.stats(0).printTo(Serial);
+  Serial.print("slow: ");
+  out.stats(1).printTo(Serial);
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,152 @@
+// Decodes in pull mode with the EncodedAudioStream: the decoded PCM data is requested with readBytes()
+// and the encoded data is read from the input stream only on demand 
+// - wav: we compare the result with the original PCM data
+// - mp3: we compare the decoded size with the result of the push mode
+#include "Arduino.h"
+#include "AudioTools.h"
+#include "AudioCodecs/CodecMP3Mini.h"
+#include "../mp3-mini/BabyElephantWalk60_mp3.h"
+
+using namespace audio_tools;  
+
+const int samples = 44100;
+int16_t pcm[samples];
+
+// Input which reports no data for some calls to simulate a network stall
+class StallingStream : public AudioStream {
+    public:
+        StallingStream(const uint8_t *data, int len) : data(data, len) {}
+        int available() {
+            calls++;
+            return isStalled() ? 0 : data.available();
+        }
+        size_t readBytes(uint8_t *buffer, size_t len) {
+            return isStalled() ? 0 : data.readBytes(buffer, len);
+        }
+        size_t write(const uint8_t *buffer, size_t len) {
+            return 0;
+        }
+        bool isStalled() {
+            return (calls / 5) % 2 == 0;
+        }
+        MemoryStream data;
+        int calls = 0;
+};
+
+// Output which just counts the bytes
+class CountingPrint : public Print {
+    public:
+        size_t write(uint8_t) { count++; return 1; }
+        size_t write(const uint8_t *data, size_t len) { count += len; return len; }
+        size_t count = 0;
+};
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+  for (int j=0;j<samples;j++){
+      pcm[j] = 10000.0 * sin(2.0 * PI * 440.0 * j / 44100.0);
+  }
+}
+
+void testWAV(){
+  // encode the pcm data
+  MemoryStream wav(1024, defaultAllocator(), true);
+  WAVEncoder encoder(wav);
+  WAVAudioInfo info = encoder.defaultConfig();
+  info.sample_rate = 44100;
+  info.channels = 1;
+  info.bits_per_sample = 16;
+  encoder.begin(info);
+  encoder.write((uint8_t*)pcm, sizeof(pcm));
+
+  // pull the decoded data with odd sized requests
+  WAVDecoder decoder;
+  EncodedAudioStream decoded(decoder, wav, 4096);
+  decoded.begin();
+  uint8_t *expected = (uint8_t*) pcm;
+  uint8_t data[333];
+  size_t pos = 0;
+  bool equal = true;
+  int max_available = 0;
+  while (equal && decoded){
+      if (wav.available()==0) decoded.endOfInput();
+      max_available = max(max_available, decoded.available());
+      size_t len = decoded.readBytes(data, sizeof(data));
+      equal = pos + len <= sizeof(pcm) && memcmp(data, expected + pos, len)==0;
+      pos += len;
+  }
+  check(max_available <= 4096, "bounded queue");
+  check(equal && pos==sizeof(pcm), "wav pull decoding");
+}
+
+size_t testMP3(){
+  // push mode as reference
+  CountingPrint pushed;
+  MP3DecoderMini push_decoder;
+  push_decoder.setOutputStream(pushed);
+  push_decoder.begin();
+  push_decoder.write(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3_len);
+  push_decoder.end();
+
+  // pull mode with StreamCopy: the queue must be able to hold the pcm data of 2 decoder buffers (16k each) 
+  MemoryStream mp3(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3_len);
+  mp3.begin();
+  MP3DecoderMini decoder;
+  EncodedAudioStream decoded(decoder, mp3, 160*1024);
+  decoded.begin();
+  CountingPrint pulled;
+  StreamCopy copier(pulled, decoded);
+  unsigned long start = millis();
+  while (decoded){
+      copier.copy();
+      if (mp3.available()==0) decoded.endOfInput();
+  }
+  Serial.print("decoded ");
+  Serial.print((long)pulled.count);
+  Serial.print(" bytes in ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+  check(pulled.count > 0 && pulled.count == pushed.count, "mp3 pull decoding");
+  return pushed.count;
+}
+
+// a stalling input must not flush the decoder or end the stream
+void testStall(size_t expected){
+  StallingStream mp3(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3_len);
+  mp3.data.begin();
+  MP3DecoderMini decoder;
+  EncodedAudioStream decoded(decoder, mp3, 160*1024);
+  decoded.begin();
+  CountingPrint pulled;
+  StreamCopy copier(pulled, decoded);
+  bool stalled_active = true;
+  while (decoded){
+      copier.copy();
+      if (mp3.data.available()==0) {
+          decoded.endOfInput();
+      } else if (mp3.isStalled()) {
+          stalled_active = stalled_active && decoded;
+      }
+  }
+  check(stalled_active, "active during stall");
+  check(pulled.count == expected, "mp3 pull decoding with stalls");
+}
+
+void loop(){
+  testWAV();
+  size_t expected = testMP3();
+  testStall(expected);
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,233 @@
+// Tests the ResampleStream: we check the number of frames, that the result does not depend on the write sizes
+// and the notification. We measure the THD+N of a 1 kHz sine and the throughput for all qualities
+#include "Arduino.h"
+#include "AudioTools.h"
+
+using namespace audio_tools;
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+// Output which accepts only max_len bytes per call
+class LimitedOutput : public Print {
+    public:
+        LimitedOutput(size_t size, size_t maxLen) : data(size) {
+            max_len = maxLen;
+        }
+        size_t write(uint8_t c) { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t len) {
+            return data.write(buffer, MIN(len, max_len));
+        }
+        MemoryStream data;
+        size_t max_len;
+};
+
+class Notified : public AudioBaseInfoDependent {
+    public:
+        void setAudioInfo(AudioBaseInfo info) { this->info = info; }
+        AudioBaseInfo info;
+};
+
+AudioBaseInfo info(int rate, int channels, int bits) {
+    AudioBaseInfo result;
+    result.sample_rate = rate;
+    result.channels = channels;
+    result.bits_per_sample = bits;
+    return result;
+}
+
+template <typename T>
+void sine(T *data, size_t frames, int channels, int rate, float freq, float amplitude) {
+    for (size_t j=0;j<frames;j++){
+        float value = amplitude * sin(2.0 * PI * freq * j / rate);
+        for (int ch=0;ch<channels;ch++){
+            data[j*channels+ch] = sizeof(T)==2 ? value * 32767.0 : value;
+        }
+    }
+}
+
+// residual of the least squares fit of a sine with the indicated frequency relative to the fitted sine in dB
+template <typename T>
+double thdn(T *data, size_t frames, int channels, int rate, float freq) {
+    double ss=0, sc=0, cc=0, ys=0, yc=0;
+    for (size_t j=0;j<frames;j++){
+        double s = sin(2.0 * PI * freq * j / rate);
+        double c = cos(2.0 * PI * freq * j / rate);
+        double y = data[j*channels];
+        ss += s*s; sc += s*c; cc += c*c; ys += y*s; yc += y*c;
+    }
+    double det = ss*cc - sc*sc;
+    double a = (ys*cc - yc*sc) / det;
+    double b = (yc*ss - ys*sc) / det;
+    double signal = 0, noise = 0;
+    for (size_t j=0;j<frames;j++){
+        double fit = a * sin(2.0 * PI * freq * j / rate) + b * cos(2.0 * PI * freq * j / rate);
+        double diff = data[j*channels] - fit;
+        signal += fit * fit;
+        noise += diff * diff;
+    }
+    return 10.0 * log10(noise / signal);
+}
+
+void testFrames() {
+    const int frames = 4800;
+    int16_t in[frames * 2];
+    sine(in, frames, 2, 48000, 1000, 0.5);
+    LimitedOutput out(frames * 4, 1000000);
+    ResampleStream resample(out, 44100);
+    Notified notified;
+    resample.setNotifyAudioChange(notified);
+    resample.setAudioInfo(info(48000, 2, 16));
+    check(notified.info.sample_rate==44100 && notified.info.channels==2 && resample.audioInfo().sample_rate==44100, "notify");
+    check(resample.write((uint8_t*)in, sizeof(in))==sizeof(in), "write");
+    // all frames except the filter look ahead are available
+    int result = out.data.available() / 4;
+    check(abs(result - 4410) <= 16, "frames");
+
+    // float data with 32 bits
+    float in_float[1000];
+    sine(in_float, 1000, 1, 22050, 1000, 0.5);
+    LimitedOutput out_float(sizeof(in_float) * 3, 1000000);
+    ResampleStreamT<float> resample_float(out_float, 44100);
+    resample_float.setAudioInfo(info(22050, 1, 32));
+    resample_float.write((uint8_t*)in_float, sizeof(in_float));
+    check(abs(out_float.data.available() / 4 - 2000) <= 16, "float frames");
+}
+
+// writing the data in odd pieces from odd addresses to an output which accepts only some bytes must provide 
+// the same result: repeating the same audio info must not restart the resampling
+void testContinuity() {
+    const int frames = 3000;
+    int16_t in[frames];
+    for (int j=0;j<frames;j++){
+        in[j] = rand();
+    }
+    LimitedOutput expected(frames * 8, 1000000);
+    ResampleStream resample1(expected, 44100, RESAMPLE_HIGH, 128);
+    resample1.setAudioInfo(info(16000, 1, 16));
+    resample1.write((uint8_t*)in, sizeof(in));
+
+    LimitedOutput actual(frames * 8, 7);
+    ResampleStream resample2(actual, 44100, RESAMPLE_HIGH, 128);
+    resample2.setAudioInfo(info(16000, 1, 16));
+    uint8_t *unaligned = new uint8_t[sizeof(in) + 1];
+    memcpy(unaligned + 1, in, sizeof(in));
+    size_t pos = 0;
+    while (pos < sizeof(in)){
+        pos += resample2.write(unaligned + 1 + pos, MIN((size_t)6, sizeof(in) - pos));
+        resample2.setAudioInfo(info(16000, 1, 16));
+    }
+    delete[] unaligned;
+    while (resample2.availableForWrite()==0){
+        resample2.flush();
+    }
+    int len = expected.data.available();
+    check(len > 0 && actual.data.available()==len, "continuity length");
+    uint8_t *data1 = new uint8_t[len];
+    uint8_t *data2 = new uint8_t[len];
+    expected.data.readBytes(data1, len);
+    actual.data.readBytes(data2, len);
+    check(memcmp(data1, data2, len)==0, "continuity");
+    delete[] data1;
+    delete[] data2;
+}
+
+// big downsampling ratios skip more input frames per output frame than the filter has taps
+double testDownsampling(ResampleQuality quality, int fromRate, int toRate) {
+    const int seconds = 2;
+    size_t frames = fromRate * seconds;
+    int16_t *in = new int16_t[frames];
+    sine(in, frames, 1, fromRate, 300, 0.5);
+    size_t expected = (uint64_t) frames * toRate / fromRate;
+    int16_t *out = new int16_t[expected + 16];
+    Resampler<int16_t> resampler;
+    resampler.begin(1, fromRate, toRate, quality);
+    // small blocks and a small output buffer
+    size_t pos = 0, produced = 0, used;
+    while (pos < frames){
+        size_t len = MIN((size_t)37, frames - pos);
+        size_t out_len = MIN((size_t)3, expected + 16 - produced);
+        produced += resampler.resample(in + pos, len, out + produced, out_len, used);
+        pos += used;
+    }
+    int skip = resampler.tapCount();
+    double result = thdn(out + skip, produced - 2 * skip, 1, toRate, 300);
+    Serial.print("downsampling ");
+    Serial.print(fromRate);
+    Serial.print(" -> ");
+    Serial.print(toRate);
+    Serial.print(": ");
+    Serial.print((int) produced);
+    Serial.print(" frames - THD+N ");
+    Serial.print(result, 1);
+    Serial.println(" dB");
+    check(produced <= expected && produced + 2 >= expected, "downsampling frames");
+    delete[] in;
+    delete[] out;
+    return result;
+}
+
+template <typename T>
+double benchmark(const char* name, ResampleQuality quality, int fromRate, int toRate) {
+    const int seconds = 10;
+    size_t frames = fromRate * seconds;
+    T *in = new T[frames * 2];
+    sine(in, frames, 2, fromRate, 1000, 0.5);
+    size_t out_frames = (uint64_t) frames * toRate / fromRate + 1;
+    T *out = new T[out_frames * 2];
+    Resampler<T> resampler;
+    resampler.begin(2, fromRate, toRate, quality);
+
+    unsigned long start = micros();
+    size_t used;
+    size_t produced = resampler.resample(in, frames, out, out_frames, used);
+    unsigned long us = micros() - start;
+
+    // we skip the start and the end of the filter
+    int skip = resampler.tapCount();
+    double result = thdn(out + skip * 2, produced - 2 * skip, 2, toRate, 1000);
+    Serial.print(name);
+    Serial.print(" ");
+    Serial.print(fromRate);
+    Serial.print(" -> ");
+    Serial.print(toRate);
+    Serial.print(": THD+N ");
+    Serial.print(result, 1);
+    Serial.print(" dB - ");
+    Serial.print(seconds * 1000000.0 / us, 0);
+    Serial.println("x realtime (stereo)");
+    delete[] in;
+    delete[] out;
+    return result;
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+}
+
+void loop(){
+  testFrames();
+  testContinuity();
+
+  check(testDownsampling(RESAMPLE_LOW, 96000, 8000) < -60, "96000 -> 8000");
+  check(testDownsampling(RESAMPLE_HIGH, 48000, 4000) < -60, "48000 -> 4000");
+
+  check(benchmark<int16_t>("int16 low", RESAMPLE_LOW, 48000, 44100) < -50, "int16 low");
+  check(benchmark<int16_t>("int16 medium", RESAMPLE_MEDIUM, 48000, 44100) < -70, "int16 medium");
+  check(benchmark<int16_t>("int16 high", RESAMPLE_HIGH, 48000, 44100) < -80, "int16 high");
+  check(benchmark<int16_t>("int16 high", RESAMPLE_HIGH, 8000, 44100) < -80, "int16 high upsampling");
+  check(benchmark<float>("float low", RESAMPLE_LOW, 48000, 44100) < -50, "float low");
+  check(benchmark<float>("float medium", RESAMPLE_MEDIUM, 48000, 44100) < -70, "float medium");
+  check(benchmark<float>("float high", RESAMPLE_HIGH, 48000, 44100) < -90, "float high");
+  check(benchmark<float>("float high", RESAMPLE_HIGH, 22050, 44100) < -90, "float high upsampling");
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}
@@ -0,0 +1,130 @@
+// Checks the output of the CsvStream and HexDumpStream and measures the throughput against a null Print
+#include "Arduino.h"
+#include "AudioTools.h"
+#include <string>
+
+using namespace audio_tools;  
+
+const int sample_rate = 44100;
+const int channels = 2;
+const int seconds = 10;
+
+// Output which just counts the bytes and the write() calls
+class NullPrint : public Print {
+    public:
+        size_t write(uint8_t) { count++; calls++; return 1; }
+        size_t write(const uint8_t *data, size_t len) { count += len; calls++; return len; }
+        size_t count = 0;
+        size_t calls = 0;
+};
+
+// Output which records the text
+class TextPrint : public Print {
+    public:
+        size_t write(uint8_t c) { text += (char)c; return 1; }
+        size_t write(const uint8_t *data, size_t len) { text.append((const char*)data, len); return len; }
+        std::string text;
+};
+
+void check(bool ok, const char* msg){
+    Serial.print(msg);
+    Serial.println(ok ? ": ok" : ": failed");
+    if (!ok) exit(1);
+}
+
+void testCsv() {
+    int16_t data[] = {0, -1, 32767, -32768, 12345, -9};
+    TextPrint out;
+    CsvStream<int16_t> csv(out, 2);
+    csv.write((uint8_t*)data, sizeof(data));
+    csv.flush();
+    check(out.text == "0, -1\r\n32767, -32768\r\n12345, -9\r\n", "csv int16_t");
+
+    int32_t data32[] = {2147483647, -2147483647-1};
+    TextPrint out32;
+    CsvStream<int32_t> csv32(out32, 2);
+    csv32.write((uint8_t*)data32, sizeof(data32));
+    csv32.flush();
+    check(out32.text == "2147483647, -2147483648\r\n", "csv int32_t");
+
+    float dataf[] = {1.5f, -0.25f};
+    TextPrint outf;
+    CsvStream<float> csvf(outf, 2);
+    csvf.write((uint8_t*)dataf, sizeof(dataf));
+    csvf.flush();
+    check(outf.text == "1.50, -0.25\r\n", "csv float");
+}
+
+void testHex() {
+    uint8_t data[17];
+    for (int j=0;j<17;j++){
+        data[j] = j * 15;
+    }
+    TextPrint out;
+    HexDumpStream hex(out);
+    hex.begin();
+    hex.write(data, sizeof(data));
+    hex.flush();
+    check(out.text == "00 0F 1E 2D 3C 4B 5A 69  - 78 87 96 A5 B4 C3 D2 E1 \r\nF0 \r\n", "hex dump");
+}
+
+void benchmark() {
+    const int samples = 1024;
+    int16_t data[samples];
+    for (int j=0;j<samples;j++){
+        data[j] = 30000.0 * sin(2.0 * PI * 440.0 * (j/channels) / sample_rate);
+    }
+    NullPrint out;
+    CsvStream<int16_t> csv(out, channels);
+    size_t total = (size_t) sample_rate * channels * seconds;
+    size_t processed = 0;
+    unsigned long start = micros();
+    while (processed < total){
+        csv.write((uint8_t*)data, sizeof(data));
+        processed += samples;
+    }
+    csv.flush();
+    unsigned long us = micros() - start;
+    Serial.print("csv: ");
+    Serial.print(seconds);
+    Serial.print(" s of stereo audio (");
+    Serial.print((unsigned long)out.count);
+    Serial.print(" chars in ");
+    Serial.print((unsigned long)out.calls);
+    Serial.print(" writes) took ");
+    Serial.print(us / 1000);
+    Serial.println(" ms");
+    check(us < seconds * 1000000ul / 10, "< 10% of real time");
+
+    NullPrint hex_out;
+    HexDumpStream hex(hex_out);
+    hex.begin();
+    start = micros();
+    for (int j=0;j<1000;j++){
+        hex.write((uint8_t*)data, sizeof(data));
+    }
+    hex.flush();
+    us = micros() - start;
+    Serial.print("hex: ");
+    Serial.print((unsigned long)sizeof(data) * 1000);
+    Serial.print(" bytes took ");
+    Serial.print(us / 1000);
+    Serial.println(" ms");
+}
+
+void setup(){
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);  
+}
+
+void loop(){
+  testCsv();
+  testHex();
+  benchmark();
+  stop();
+}
+
+int main(){
+  setup();
+  while(true) loop();
+}